@@ -0,0 +1,108 @@
+#include "arena.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Main block of the given size, or none at all when the heap is exhausted: every request then takes the slow path
+static char* allocateMainBlock(size_t& capacity) {
+    char* buffer = static_cast<char*>(malloc(capacity));
+    if (buffer == nullptr) {
+        fprintf(stderr, "ERROR::FRAME_ARENA::OUT_OF_MEMORY\n%zu bytes\n", capacity);
+        capacity = 0;
+    }
+    return buffer;
+}
+
+// The main block is set up outside of any frame, it only counts in the totals
+FrameArena::FrameArena(size_t capacity) : capacity(capacity), offset(0), overflowBytes(0), overflow(nullptr), stats() {
+    buffer = allocateMainBlock(this->capacity);
+    stats.capacity = this->capacity;
+    stats.totalHeapAllocations = 1;
+}
+
+FrameArena::~FrameArena() {
+    while (overflow != nullptr) {
+        OverflowBlock* next = overflow->next;
+        free(overflow);
+        overflow = next;
+    }
+    free(buffer);
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    stats.allocations++;
+
+    // Fast path: bump inside the main block
+    size_t start = alignUp(reinterpret_cast<uintptr_t>(buffer) + offset, alignment) - reinterpret_cast<uintptr_t>(buffer);
+    if (buffer != nullptr && start + size <= capacity) {
+        offset = start + size;
+        stats.bytesUsed = offset + overflowBytes;
+        if (stats.bytesUsed > stats.peakBytes)
+            stats.peakBytes = stats.bytesUsed;
+        return buffer + start;
+    }
+
+    // Slow path: the frame outgrew the arena, keep going with a dedicated block until the next reset
+    size_t blockSize = alignUp(sizeof(OverflowBlock), alignment) + size;
+    OverflowBlock* block = static_cast<OverflowBlock*>(malloc(blockSize + alignment));
+    if (block == nullptr)
+        return nullptr;
+
+    block->next = overflow;
+    overflow = block;
+    overflowBytes += size + alignment;
+    stats.heapAllocations++;
+    stats.totalHeapAllocations++;
+
+    stats.bytesUsed = offset + overflowBytes;
+    if (stats.bytesUsed > stats.peakBytes)
+        stats.peakBytes = stats.bytesUsed;
+
+    uintptr_t data = alignUp(reinterpret_cast<uintptr_t>(block) + sizeof(OverflowBlock), alignment);
+    return reinterpret_cast<void*>(data);
+}
+
+void FrameArena::reset() {
+    size_t needed = offset + overflowBytes;
+    bool grow = overflow != nullptr;
+
+    size_t frees = 0;
+    while (overflow != nullptr) {
+        OverflowBlock* next = overflow->next;
+        free(overflow);
+        overflow = next;
+        frees++;
+    }
+
+    stats.allocations = 0;
+    stats.heapAllocations = 0;
+    stats.heapFrees = frees;
+    stats.totalHeapFrees += frees;
+
+    // Grow the main block so the same frame fits without overflowing next time. Like the frees above,
+    // this belongs to the frame that overflowed and was already reported there, so the next frame
+    // starts with no heap allocation.
+    if (grow) {
+        free(buffer);
+        capacity = capacity * 2 > needed ? capacity * 2 : needed;
+        buffer = allocateMainBlock(capacity);
+
+        stats.capacity = capacity;
+        stats.heapFrees++;
+        stats.totalHeapAllocations++;
+        stats.totalHeapFrees++;
+    }
+
+    offset = 0;
+    overflowBytes = 0;
+    stats.bytesUsed = 0;
+}
+
+FrameArenaStats FrameArena::getStats() const {
+    return stats;
+}
@@ -0,0 +1,106 @@
+#ifndef QUATERNION_ARENA_H
+#define QUATERNION_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+struct FrameArenaStats
+{
+public:
+    size_t capacity;        // Size of the main block
+    size_t bytesUsed;       // Bytes handed out since the last reset
+    size_t peakBytes;       // Highest bytesUsed ever reached
+    size_t allocations;     // allocate() calls since the last reset
+    size_t heapAllocations; // malloc calls by allocate() since the last reset (0 in a steady-state frame)
+    size_t heapFrees;       // free calls made by the last reset (0 in a steady-state frame)
+    size_t totalHeapAllocations;
+    size_t totalHeapFrees;
+};
+
+// Linear allocator for per-frame temporaries.
+// Allocation is a pointer bump, deallocation is a no-op and everything is released at once by reset().
+// When a frame asks for more than the capacity, the extra requests go to overflow blocks and the next
+// reset() grows the main block to the peak, so once the frame size is stable no malloc/free happens anymore.
+struct FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity = 1 << 20);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // nullptr only when the heap is exhausted
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    void reset();
+
+    template<typename T>
+    T* allocate(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    FrameArenaStats getStats() const;
+
+private:
+    struct OverflowBlock
+    {
+        OverflowBlock* next;
+    };
+
+    char* buffer;
+    size_t capacity;
+    size_t offset;
+    size_t overflowBytes;
+    OverflowBlock* overflow;
+
+    FrameArenaStats stats;
+};
+
+// STL-compatible allocator drawing from a FrameArena, e.g. std::vector<T, ArenaAllocator<T>>.
+// The container must not outlive the frame: its memory is reclaimed by FrameArena::reset().
+template<typename T>
+struct ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    FrameArena* arena;
+
+    explicit ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        T* memory = arena->allocate<T>(count);
+        if (memory == nullptr)
+            throw std::bad_alloc();
+        return memory;
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+// Scratch array of count copies of value for functions taking an optional FrameArena* scratch:
+// it comes from the arena when there is one (and lives until its reset), otherwise from storage.
+template<typename T>
+T* allocateScratch(FrameArena* scratch, std::vector<T>& storage, size_t count, const T& value) {
+    T* memory = scratch != nullptr ? scratch->allocate<T>(count) : nullptr;
+    if (memory == nullptr) {
+        storage.assign(count, value);
+        return storage.data();
+    }
+
+    std::uninitialized_fill(memory, memory + count, value);
+    return memory;
+}
+
+#endif //QUATERNION_ARENA_H
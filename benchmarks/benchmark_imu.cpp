@@ -0,0 +1,43 @@
+// Gyroscope integration throughput in device samples per second
+#include "../imu.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static void run(size_t deviceCount, ImuIntegrator::Method method, const char* name) {
+    const size_t SAMPLES = 64;
+    const double DT = 1.0 / 1000;
+
+    std::mt19937_64 random(1);
+    std::uniform_real_distribution<double> rate(-10, 10);
+    std::vector<double> wx(deviceCount * SAMPLES), wy(deviceCount * SAMPLES), wz(deviceCount * SAMPLES);
+    for (size_t i = 0; i < wx.size(); ++i) {
+        wx[i] = rate(random);
+        wy[i] = rate(random);
+        wz[i] = rate(random);
+    }
+
+    ImuIntegrator integrator = ImuIntegrator(deviceCount, method);
+
+    // At least a few hundred million device samples so the timing is stable
+    size_t rounds = 200000000 / (deviceCount * SAMPLES) + 1;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round)
+        integrator.integrate(wx.data(), wy.data(), wz.data(), SAMPLES, DT);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%-16s %8zu devices  %8.1f M samples/s\n", name, deviceCount, rounds * deviceCount * SAMPLES / seconds / 1e6);
+}
+
+int main() {
+    size_t deviceCounts[] = {64, 1024, 16384, 262144};
+
+    for (size_t deviceCount : deviceCounts) {
+        run(deviceCount, ImuIntegrator::EXPONENTIAL_MAP, "exponential map");
+        run(deviceCount, ImuIntegrator::RUNGE_KUTTA_4, "runge-kutta 4");
+    }
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+// Sandwich rotation q * v * ~q as an expression against the multiply().multiply(conjugate()) chain, in M rotations/s
+#include "../library.h"
+#include "../quaternion_expr.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Double3::rotate as it was written before the expression templates
+static Double3 rotateWithChain(const Double3& point, const Quaternion& quaternion, const Double3& origin) {
+    Double3 tempPoint = Double3(point.x - origin.x, point.y - origin.z, point.z - origin.y);
+
+    Quaternion temp = quaternion;
+    temp = temp.getUnit();
+    Quaternion result = temp.multiply(Quaternion(0, tempPoint.x, tempPoint.y, tempPoint.z)).multiply(temp.conjugate());
+
+    return Double3(result.b + origin.x, result.d + origin.y, result.c + origin.z);
+}
+
+template<typename Rotate>
+static void run(const char* name, const std::vector<Quaternion>& rotations, const std::vector<Double3>& points, Rotate rotate) {
+    // A few hundred million rotations so the timing is stable
+    const size_t ROUNDS = 200000000 / points.size() + 1;
+
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        for (size_t i = 0; i < points.size(); ++i) {
+            Double3 rotated = rotate(points[i], rotations[i]);
+            checksum += rotated.x + rotated.y + rotated.z;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The checksum keeps the rotations from being optimized away
+    printf("%-28s %8.1f M rotations/s  (checksum %g)\n", name, ROUNDS * points.size() / seconds / 1e6, checksum);
+}
+
+int main() {
+    const size_t COUNT = 4096;
+
+    std::mt19937_64 random(1);
+    std::normal_distribution<double> normal;
+    std::vector<Quaternion> rotations(COUNT, Quaternion(1, 0, 0, 0));
+    std::vector<Double3> points(COUNT);
+    for (size_t i = 0; i < COUNT; ++i) {
+        rotations[i] = Quaternion(normal(random), normal(random), normal(random), normal(random)).getUnit();
+        points[i] = Double3(normal(random), normal(random), normal(random));
+    }
+    Double3 origin = Double3(0.5, -1, 2);
+
+    run("Double3::rotate (expression)", rotations, points, [&](Double3 point, const Quaternion& q) {
+        return point.rotate(q, origin);
+    });
+    run("Double3::rotate (chain)", rotations, points, [&](Double3 point, const Quaternion& q) {
+        return rotateWithChain(point, q, origin);
+    });
+
+    // The products alone, without the normalization and origin change of Double3::rotate
+    run("q * v * ~q", rotations, points, [](Double3 point, const Quaternion& q) {
+        Quaternion v = Quaternion(0, point.x, point.y, point.z);
+        Quaternion result = q * v * ~q;
+        return Double3(result.b, result.c, result.d);
+    });
+    run("q.multiply(v).multiply(~q)", rotations, points, [](Double3 point, Quaternion q) {
+        Quaternion result = q.multiply(Quaternion(0, point.x, point.y, point.z)).multiply(q.conjugate());
+        return Double3(result.b, result.c, result.d);
+    });
+
+    return 0;
+}
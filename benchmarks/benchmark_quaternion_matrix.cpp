@@ -0,0 +1,105 @@
+// QuaternionMatrix products: quaternion fast path, general kernel and the original product, in M products/s
+#include "../library.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// QuaternionMatrix::multiply before the fast path and the row kernel: a copy of the argument, 64 products
+static QuaternionMatrix multiplyOriginal(const QuaternionMatrix& left, const QuaternionMatrix& right) {
+    QuaternionMatrix other = right;
+    return {
+            left.a1 * other.a1 + left.a2 * other.b1 + left.a3 * other.c1 + left.a4 * other.d1,
+            left.a1 * other.a2 + left.a2 * other.b2 + left.a3 * other.c2 + left.a4 * other.d2,
+            left.a1 * other.a3 + left.a2 * other.b3 + left.a3 * other.c3 + left.a4 * other.d3,
+            left.a1 * other.a4 + left.a2 * other.b4 + left.a3 * other.c4 + left.a4 * other.d4,
+
+            left.b1 * other.a1 + left.b2 * other.b1 + left.b3 * other.c1 + left.b4 * other.d1,
+            left.b1 * other.a2 + left.b2 * other.b2 + left.b3 * other.c2 + left.b4 * other.d2,
+            left.b1 * other.a3 + left.b2 * other.b3 + left.b3 * other.c3 + left.b4 * other.d3,
+            left.b1 * other.a4 + left.b2 * other.b4 + left.b3 * other.c4 + left.b4 * other.d4,
+
+            left.c1 * other.a1 + left.c2 * other.b1 + left.c3 * other.c1 + left.c4 * other.d1,
+            left.c1 * other.a2 + left.c2 * other.b2 + left.c3 * other.c2 + left.c4 * other.d2,
+            left.c1 * other.a3 + left.c2 * other.b3 + left.c3 * other.c3 + left.c4 * other.d3,
+            left.c1 * other.a4 + left.c2 * other.b4 + left.c3 * other.c4 + left.c4 * other.d4,
+
+            left.d1 * other.a1 + left.d2 * other.b1 + left.d3 * other.c1 + left.d4 * other.d1,
+            left.d1 * other.a2 + left.d2 * other.b2 + left.d3 * other.c2 + left.d4 * other.d2,
+            left.d1 * other.a3 + left.d2 * other.b3 + left.d3 * other.c3 + left.d4 * other.d3,
+            left.d1 * other.a4 + left.d2 * other.b4 + left.d3 * other.c4 + left.d4 * other.d4
+    };
+}
+
+// Right-multiplication matrix of q (v -> v * q): orthogonal for a unit q like toMatrix(), but never in
+// quaternion form unless q is real, so chains of them take the general kernel without growing
+static QuaternionMatrix rightMatrix(const Quaternion& q) {
+    return {
+            q.a, -q.b, -q.c, -q.d,
+            q.b, q.a, q.d, -q.c,
+            q.c, -q.d, q.a, q.b,
+            q.d, q.c, -q.b, q.a
+    };
+}
+
+// Chained products wait for each other, independent ones show the throughput
+template<typename Multiply>
+static double run(const char* name, const std::vector<QuaternionMatrix>& matrices, bool chained, Multiply multiply) {
+    // A few hundred million products so the timing is stable
+    const size_t ROUNDS = 100000000 / matrices.size() + 1;
+
+    std::vector<QuaternionMatrix> products(matrices.size(), matrices[0]);
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        if (chained) {
+            QuaternionMatrix chain = matrices[0];
+            for (size_t i = 1; i < matrices.size(); ++i)
+                chain = multiply(chain, matrices[i]);
+            checksum += chain.a1;
+        } else {
+            for (size_t i = 1; i < matrices.size(); ++i)
+                products[i] = multiply(matrices[i - 1], matrices[i]);
+            checksum += products[round % matrices.size()].a1;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The checksum keeps the products from being optimized away
+    double rate = ROUNDS * (matrices.size() - 1) / seconds / 1e6;
+    printf("%-44s %8.1f M products/s  (checksum %g)\n", name, rate, checksum);
+    return rate;
+}
+
+int main() {
+    const size_t COUNT = 1024;
+
+    std::mt19937_64 random(1);
+    std::normal_distribution<double> normal;
+    std::vector<QuaternionMatrix> quaternionMatrices, generalMatrices;
+    for (size_t i = 0; i < COUNT; ++i) {
+        Quaternion q = Quaternion(normal(random), normal(random), normal(random), normal(random)).getUnit();
+        quaternionMatrices.push_back(q.toMatrix());
+        generalMatrices.push_back(rightMatrix(q));
+    }
+
+    auto multiply = [](const QuaternionMatrix& left, const QuaternionMatrix& right) {
+        return QuaternionMatrix(left).multiply(right);
+    };
+    auto original = [](const QuaternionMatrix& left, const QuaternionMatrix& right) {
+        return multiplyOriginal(left, right);
+    };
+
+    for (int chained = 1; chained >= 0; --chained) {
+        const char* mode = chained ? "chained" : "independent";
+        printf("%s products\n", mode);
+        double fast = run("  quaternion matrices, multiply", quaternionMatrices, chained, multiply);
+        double fastOriginal = run("  quaternion matrices, original", quaternionMatrices, chained, original);
+        double general = run("  general matrices, multiply", generalMatrices, chained, multiply);
+        double generalOriginal = run("  general matrices, original", generalMatrices, chained, original);
+        printf("  fast path %.2fx the original product, general kernel %.2fx\n", fast / fastOriginal, general / generalOriginal);
+    }
+
+    return 0;
+}
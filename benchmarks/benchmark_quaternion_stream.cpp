@@ -0,0 +1,68 @@
+// Quaternion stream encoding and decoding throughput in GB/s of raw quaternions (32 bytes each)
+#include "../quaternion_stream.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static void run(const std::vector<Quaternion>& quaternions, StreamEncoding encoding, const char* name) {
+    size_t count = quaternions.size();
+    std::vector<Quaternion> decoded(count, Quaternion(1, 0, 0, 0));
+
+    // At least a few GB of quaternions each way so the timing is stable
+    size_t rounds = 4000000000 / (count * sizeof(Quaternion)) + 1;
+
+    size_t streamSize = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        StreamWriter writer;
+        writer.writeQuaternions(quaternions.data(), count, encoding);
+        streamSize = writer.data.size();
+    }
+    double encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    StreamWriter writer;
+    writer.writeQuaternions(quaternions.data(), count, encoding);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        StreamReader reader = StreamReader(writer.data.data(), writer.data.size());
+        StreamChunkView chunk;
+        size_t position = 0;
+        while (reader.next(chunk)) {
+            chunk.decodeQuaternions(decoded.data() + position);
+            position += chunk.count;
+        }
+    }
+    double decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double bytes = (double)rounds * count * sizeof(Quaternion);
+    printf("%-12s %6.2f bytes/record  encode %6.2f GB/s  decode %6.2f GB/s\n", name, (double)streamSize / count,
+           bytes / encodeSeconds / 1e9, bytes / decodeSeconds / 1e9);
+}
+
+int main() {
+    const size_t COUNT = 1 << 20;
+
+    // A smooth time series (a slow rotation with a little noise), what the delta encodings are meant for
+    std::mt19937_64 random(3);
+    std::normal_distribution<double> noise(0, 1e-4);
+    std::vector<Quaternion> quaternions(COUNT, Quaternion(1, 0, 0, 0));
+    for (size_t i = 0; i < COUNT; ++i) {
+        double angle = i * 1e-4;
+        quaternions[i] = Quaternion(cos(angle) + noise(random), sin(angle) * 0.6 + noise(random),
+                                    sin(angle) * 0.8 + noise(random), noise(random)).getUnit();
+    }
+
+    run(quaternions, STREAM_QUATERNION_RAW, "raw");
+    run(quaternions, STREAM_QUATERNION_SMALLEST3_29, "smallest3 29");
+    run(quaternions, STREAM_QUATERNION_SMALLEST3_32, "smallest3 32");
+    run(quaternions, STREAM_QUATERNION_SMALLEST3_48, "smallest3 48");
+    run(quaternions, STREAM_QUATERNION_DELTA_29, "delta 29");
+    run(quaternions, STREAM_QUATERNION_DELTA_32, "delta 32");
+    run(quaternions, STREAM_QUATERNION_DELTA_48, "delta 48");
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#ifndef QUATERNION_FRAME_PIPELINE_H
+#define QUATERNION_FRAME_PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <thread>
+
+// Lock-free queue for exactly one producer thread and one consumer thread
+template<typename T, size_t Capacity>
+struct SpscQueue
+{
+public:
+    bool push(const T& value) {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % (Capacity + 1);
+        if (next == head.load(std::memory_order_acquire))
+            return false;
+
+        items[tail] = value;
+        this->tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == tail.load(std::memory_order_acquire))
+            return false;
+
+        value = items[head];
+        this->head.store((head + 1) % (Capacity + 1), std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[Capacity + 1];
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+// Runs the CPU side of a frame on a worker thread while the render thread submits the previous one.
+// The render thread acquire()s a job, fills its inputs and submit()s it, the worker runs work() on it,
+// and the render thread later takes it back with waitCompleted(), uses the result and release()s it.
+// With a latency of N frames, N + 1 jobs rotate so the worker can fill one while the others are in use.
+// Only those N + 1 jobs are created, each built from jobArguments.
+template<typename Job>
+struct FramePipeline
+{
+public:
+    static const int MAX_LATENCY = 2;
+
+    template<typename... JobArguments>
+    FramePipeline(int latency, std::function<void(Job&)> work, const JobArguments&... jobArguments) :
+            latency(latency < 0 ? 0 : latency > MAX_LATENCY ? MAX_LATENCY : latency), inFlight(0), freeCount(0),
+            work(work), running(true) {
+        for (int i = 0; i <= this->latency; ++i) {
+            jobs[i].reset(new Job(jobArguments...));
+            freeJobs[freeCount++] = jobs[i].get();
+        }
+
+        worker = std::thread([this]() { runWorker(); });
+    }
+
+    ~FramePipeline() {
+        running.store(false, std::memory_order_release);
+        worker.join();
+    }
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // Render thread: a job that is not in flight. If the caller did not release enough jobs the oldest
+    // completed one is recycled, its result is dropped.
+    Job& acquire() {
+        if (freeCount == 0)
+            release(waitCompleted());
+        return *freeJobs[--freeCount];
+    }
+
+    // Render thread: hand a filled job to the worker
+    void submit(Job& job) {
+        inFlight++;
+        while (!pending.push(&job))
+            std::this_thread::yield();
+    }
+
+    // Render thread: true when more jobs are in flight than the configured latency allows,
+    // the oldest one should then be waited for and used
+    bool isBehind() const {
+        return inFlight > latency;
+    }
+
+    // Render thread: oldest submitted job, once the worker is done with it
+    Job& waitCompleted() {
+        Job* job = nullptr;
+        while (!completed.pop(job))
+            std::this_thread::yield();
+        inFlight--;
+        return *job;
+    }
+
+    // Render thread: the job's result is no longer needed
+    void release(Job& job) {
+        freeJobs[freeCount++] = &job;
+    }
+
+    int getLatency() const {
+        return latency;
+    }
+
+private:
+    int latency;
+    int inFlight;
+
+    std::unique_ptr<Job> jobs[MAX_LATENCY + 1];
+    Job* freeJobs[MAX_LATENCY + 1];
+    int freeCount;
+
+    SpscQueue<Job*, MAX_LATENCY + 1> pending;
+    SpscQueue<Job*, MAX_LATENCY + 1> completed;
+
+    std::function<void(Job&)> work;
+    std::atomic<bool> running;
+    std::thread worker;
+
+    void runWorker() {
+        int idle = 0;
+        while (running.load(std::memory_order_acquire)) {
+            Job* job = nullptr;
+            if (!pending.pop(job)) {
+                // Spin a little for low latency, then stop burning the core while the render thread is busy
+                if (++idle < 64)
+                    std::this_thread::yield();
+                else
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+
+            idle = 0;
+            work(*job);
+            while (!completed.push(job))
+                std::this_thread::yield();
+        }
+    }
+};
+
+#endif //QUATERNION_FRAME_PIPELINE_H
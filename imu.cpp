@@ -0,0 +1,162 @@
+#include "imu.h"
+#include "parallel.h"
+#include "vector_math.h"
+
+#include <cmath>
+
+// Devices per thread below which threading is not worth it
+static const size_t IMU_DEVICES_PER_WORKER = 1024;
+
+// Time derivative of an orientation: q * (0, x, y, z) / 2
+static inline void orientationDerivative(double a, double b, double c, double d, double x, double y, double z,
+                                         double& da, double& db, double& dc, double& dd) {
+    da = 0.5 * (-b * x - c * y - d * z);
+    db = 0.5 * (a * x + c * z - d * y);
+    dc = 0.5 * (a * y - b * z + d * x);
+    dd = 0.5 * (a * z + b * y - c * x);
+}
+
+// One step of count devices. The per-device arrays never overlap, which the __restrict parameters tell
+// the compiler so it vectorizes the loops without runtime overlap checks.
+static void exponentialMapStep(const double* __restrict x, const double* __restrict y, const double* __restrict z,
+                               double* __restrict qa, double* __restrict qb, double* __restrict qc, double* __restrict qd,
+                               size_t count, double dt) {
+    for (size_t i = 0; i < count; ++i) {
+        double norm = sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+        double sine, cosine;
+        sinCos(norm * dt / 2, sine, cosine);
+        // sin(|w| dt / 2) / |w|. A device at rest gives 0 / tiny = 0, which is right since it multiplies
+        // a zero angular velocity, and avoids a branch.
+        double s = sine / (norm + 1e-300);
+
+        double ra = cosine;
+        double rb = x[i] * s;
+        double rc = y[i] * s;
+        double rd = z[i] * s;
+
+        double na = qa[i] * ra - qb[i] * rb - qc[i] * rc - qd[i] * rd;
+        double nb = qa[i] * rb + qb[i] * ra + qc[i] * rd - qd[i] * rc;
+        double nc = qa[i] * rc - qb[i] * rd + qc[i] * ra + qd[i] * rb;
+        double nd = qa[i] * rd + qb[i] * rc - qc[i] * rb + qd[i] * ra;
+        qa[i] = na;
+        qb[i] = nb;
+        qc[i] = nc;
+        qd[i] = nd;
+    }
+}
+
+static void rungeKutta4Step(const double* __restrict x, const double* __restrict y, const double* __restrict z,
+                            double* __restrict qa, double* __restrict qb, double* __restrict qc, double* __restrict qd,
+                            double* __restrict px, double* __restrict py, double* __restrict pz, size_t count, double dt) {
+    for (size_t i = 0; i < count; ++i) {
+        double mx = (px[i] + x[i]) / 2;
+        double my = (py[i] + y[i]) / 2;
+        double mz = (pz[i] + z[i]) / 2;
+
+        double k1a, k1b, k1c, k1d;
+        orientationDerivative(qa[i], qb[i], qc[i], qd[i], px[i], py[i], pz[i], k1a, k1b, k1c, k1d);
+
+        double k2a, k2b, k2c, k2d;
+        orientationDerivative(qa[i] + dt / 2 * k1a, qb[i] + dt / 2 * k1b, qc[i] + dt / 2 * k1c, qd[i] + dt / 2 * k1d,
+                              mx, my, mz, k2a, k2b, k2c, k2d);
+
+        double k3a, k3b, k3c, k3d;
+        orientationDerivative(qa[i] + dt / 2 * k2a, qb[i] + dt / 2 * k2b, qc[i] + dt / 2 * k2c, qd[i] + dt / 2 * k2d,
+                              mx, my, mz, k3a, k3b, k3c, k3d);
+
+        double k4a, k4b, k4c, k4d;
+        orientationDerivative(qa[i] + dt * k3a, qb[i] + dt * k3b, qc[i] + dt * k3c, qd[i] + dt * k3d,
+                              x[i], y[i], z[i], k4a, k4b, k4c, k4d);
+
+        qa[i] += dt / 6 * (k1a + 2 * k2a + 2 * k3a + k4a);
+        qb[i] += dt / 6 * (k1b + 2 * k2b + 2 * k3b + k4b);
+        qc[i] += dt / 6 * (k1c + 2 * k2c + 2 * k3c + k4c);
+        qd[i] += dt / 6 * (k1d + 2 * k2d + 2 * k3d + k4d);
+
+        px[i] = x[i];
+        py[i] = y[i];
+        pz[i] = z[i];
+    }
+}
+
+static void renormalizeStep(double* __restrict qa, double* __restrict qb, double* __restrict qc, double* __restrict qd,
+                            size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        double invNorm = 1 / sqrt(qa[i] * qa[i] + qb[i] * qb[i] + qc[i] * qc[i] + qd[i] * qd[i]);
+        qa[i] *= invNorm;
+        qb[i] *= invNorm;
+        qc[i] *= invNorm;
+        qd[i] *= invNorm;
+    }
+}
+
+ImuIntegrator::ImuIntegrator(size_t deviceCount, Method method, size_t renormalizeInterval) :
+        method(method), deviceCount(deviceCount), renormalizeInterval(renormalizeInterval),
+        samplesSinceRenormalize(0),
+        a(deviceCount, 1), b(deviceCount, 0), c(deviceCount, 0), d(deviceCount, 0),
+        previousX(deviceCount, 0), previousY(deviceCount, 0), previousZ(deviceCount, 0),
+        hasPreviousSample(deviceCount, 0) {}
+
+void ImuIntegrator::integrate(const double* wx, const double* wy, const double* wz, double dt) {
+    integrate(wx, wy, wz, 1, dt);
+}
+
+void ImuIntegrator::integrate(const double* wx, const double* wy, const double* wz, size_t sampleCount, double dt) {
+    if (sampleCount == 0)
+        return;
+
+    // Devices without history (new or reset) assume a constant angular velocity over their first step
+    for (size_t i = 0; i < deviceCount; ++i) {
+        if (!hasPreviousSample[i]) {
+            previousX[i] = wx[i];
+            previousY[i] = wy[i];
+            previousZ[i] = wz[i];
+            hasPreviousSample[i] = 1;
+        }
+    }
+
+    parallelRanges(deviceCount, getWorkerCount(deviceCount, IMU_DEVICES_PER_WORKER), [&](size_t, size_t begin, size_t end) {
+        integrateDevices(wx, wy, wz, sampleCount, dt, begin, end);
+    });
+
+    if (renormalizeInterval != 0)
+        samplesSinceRenormalize = (samplesSinceRenormalize + sampleCount) % renormalizeInterval;
+}
+
+void ImuIntegrator::integrateDevices(const double* wx, const double* wy, const double* wz, size_t sampleCount, double dt,
+                                     size_t begin, size_t end) {
+    for (size_t sample = 0; sample < sampleCount; ++sample) {
+        const double* x = wx + sample * deviceCount + begin;
+        const double* y = wy + sample * deviceCount + begin;
+        const double* z = wz + sample * deviceCount + begin;
+
+        if (method == EXPONENTIAL_MAP)
+            exponentialMapStep(x, y, z, &a[begin], &b[begin], &c[begin], &d[begin], end - begin, dt);
+        else
+            rungeKutta4Step(x, y, z, &a[begin], &b[begin], &c[begin], &d[begin],
+                            &previousX[begin], &previousY[begin], &previousZ[begin], end - begin, dt);
+
+        if (renormalizeInterval != 0 && (samplesSinceRenormalize + sample + 1) % renormalizeInterval == 0)
+            renormalizeStep(&a[begin], &b[begin], &c[begin], &d[begin], end - begin);
+    }
+}
+
+Quaternion ImuIntegrator::getOrientation(size_t device) const {
+    return Quaternion(a[device], b[device], c[device], d[device]);
+}
+
+// The device restarts from a unit quaternion with no angular velocity history, so neither the shared
+// renormalization schedule nor the previous rate of its old motion affect it
+void ImuIntegrator::setOrientation(size_t device, const Quaternion& orientation) {
+    double invNorm = 1 / sqrt(orientation.a * orientation.a + orientation.b * orientation.b
+                              + orientation.c * orientation.c + orientation.d * orientation.d);
+    a[device] = orientation.a * invNorm;
+    b[device] = orientation.b * invNorm;
+    c[device] = orientation.c * invNorm;
+    d[device] = orientation.d * invNorm;
+    hasPreviousSample[device] = 0;
+}
+
+size_t ImuIntegrator::getDeviceCount() const {
+    return deviceCount;
+}
@@ -0,0 +1,53 @@
+#ifndef QUATERNION_IMU_H
+#define QUATERNION_IMU_H
+
+#include "library.h"
+
+#include <cstddef>
+#include <vector>
+
+// Integrates gyroscope samples (body-frame angular velocity in rad/s) into orientations for many devices at once.
+// State and samples are stored one array per component (x of every device, then y, ...) so each step
+// is the same arithmetic across all devices and the device loops vectorize.
+struct ImuIntegrator
+{
+public:
+    enum Method
+    {
+        // Exact rotation for a constant angular velocity over the step: q = q * exp(w * dt / 2)
+        EXPONENTIAL_MAP,
+        // Runge-Kutta 4 on dq/dt = q * w / 2, angular velocity interpolated between the previous and current sample
+        RUNGE_KUTTA_4
+    };
+
+    ImuIntegrator(size_t deviceCount, Method method = EXPONENTIAL_MAP, size_t renormalizeInterval = 32);
+
+    // One sample per device: wx[i], wy[i], wz[i] belong to device i
+    void integrate(const double* wx, const double* wy, const double* wz, double dt);
+    // sampleCount samples per device, sample-major: sample s of device i is at index s * deviceCount + i
+    void integrate(const double* wx, const double* wy, const double* wz, size_t sampleCount, double dt);
+
+    Quaternion getOrientation(size_t device) const;
+    // Normalizes the orientation and forgets the device's angular velocity history
+    void setOrientation(size_t device, const Quaternion& orientation);
+    size_t getDeviceCount() const;
+
+private:
+    Method method;
+    size_t deviceCount;
+    size_t renormalizeInterval;
+    // Every device receives every sample, so one count serves them all
+    size_t samplesSinceRenormalize;
+
+    // Orientation of every device
+    std::vector<double> a, b, c, d;
+    // Last angular velocity of every device, used by RUNGE_KUTTA_4
+    std::vector<double> previousX, previousY, previousZ;
+    // 0 until the device got its first sample since creation or setOrientation()
+    std::vector<unsigned char> hasPreviousSample;
+
+    void integrateDevices(const double* wx, const double* wy, const double* wz, size_t sampleCount, double dt,
+                          size_t begin, size_t end);
+};
+
+#endif //QUATERNION_IMU_H
@@ -1,6 +1,13 @@
 #include "library.h"
+#include "arena.h"
+#include "parallel.h"
+#include "quaternion_expr.h"
+#include "vector_math.h"
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
 
 // ----- QUATERNIONS -----
 
@@ -71,13 +78,108 @@ Quaternion Quaternion::eulerAngles(double rads, Double3 axis) {
     return Quaternion(cos(rads / 2), axisUnit.x * angleSin, axisUnit.y * angleSin, axisUnit.z * angleSin);
 }
 
+static inline void expValues(double a, double b, double c, double d, Quaternion& out) {
+    double vNorm = std::sqrt(b * b + c * c + d * d);
+    double scale = std::exp(a);
+    // sin(|v|) / |v|, which tends to 1 for a real quaternion
+    double s = vNorm > 0 ? std::sin(vNorm) / vNorm : 1;
+
+    out.a = scale * std::cos(vNorm);
+    out.b = scale * s * b;
+    out.c = scale * s * c;
+    out.d = scale * s * d;
+}
+
+static inline void logValues(double a, double b, double c, double d, Quaternion& out) {
+    double vNorm = std::sqrt(b * b + c * c + d * d);
+    double norm = std::sqrt(a * a + vNorm * vNorm);
+    double angle = std::atan2(vNorm, a);
+    // angle / |v|, which tends to 1 / |q| for a positive real quaternion
+    double s = vNorm > 0 ? angle / vNorm : 1 / norm;
+
+    out.a = std::log(norm);
+    out.b = s * b;
+    out.c = s * c;
+    out.d = s * d;
+
+    // A negative real quaternion is a half turn around any axis, x is picked
+    if (vNorm == 0 && a < 0)
+        out.b = M_PI;
+}
+
+// Same as expValues and logValues with the vector_math.h functions and without branches, for the batch loops.
+// A zero vector part divides 0 by a tiny offset instead of taking the limit: the factor is wrong but multiplies
+// zeros. Results match the scalar versions to a few ulp.
+
+static inline void expValuesVectorized(double a, double b, double c, double d, Quaternion& out) {
+    double vNorm = sqrt(b * b + c * c + d * d);
+    double scale = expPolynomial(a);
+    double sine, cosine;
+    sinCos(vNorm, sine, cosine);
+    double s = scale * sine / (vNorm + 1e-300);
+
+    out.a = scale * cosine;
+    out.b = s * b;
+    out.c = s * c;
+    out.d = s * d;
+}
+
+static inline void logValuesVectorized(double a, double b, double c, double d, Quaternion& out) {
+    double vNorm = sqrt(b * b + c * c + d * d);
+    double norm = sqrt(a * a + vNorm * vNorm);
+    double s = atan2Polynomial(vNorm, a) / (vNorm + 1e-300);
+
+    out.a = logPolynomial(norm);
+    out.c = s * c;
+    out.d = s * d;
+
+    uint64_t negativeReal = (0 - ((bitsOf(vNorm) - 1) >> 63)) & (0 - (bitsOf(a) >> 63));
+    out.b = doubleOf(selectBits(negativeReal, bitsOf(s * b), bitsOf(M_PI)));
+}
+
+Quaternion Quaternion::exp() {
+    Quaternion result = Quaternion();
+    expValues(a, b, c, d, result);
+    return result;
+}
+
+Quaternion Quaternion::log() {
+    Quaternion result = Quaternion();
+    logValues(a, b, c, d, result);
+    return result;
+}
+
+Quaternion Quaternion::pow(double t) {
+    return this->log().multiply(t).exp();
+}
+
+void Quaternion::expAll(const Quaternion* quaternions, Quaternion* out, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        expValuesVectorized(quaternions[i].a, quaternions[i].b, quaternions[i].c, quaternions[i].d, out[i]);
+}
+
+void Quaternion::logAll(const Quaternion* quaternions, Quaternion* out, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        logValuesVectorized(quaternions[i].a, quaternions[i].b, quaternions[i].c, quaternions[i].d, out[i]);
+}
+
+void Quaternion::powAll(const Quaternion* quaternions, double t, Quaternion* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        Quaternion logarithm = Quaternion();
+        logValuesVectorized(quaternions[i].a, quaternions[i].b, quaternions[i].c, quaternions[i].d, logarithm);
+        expValuesVectorized(logarithm.a * t, logarithm.b * t, logarithm.c * t, logarithm.d * t, out[i]);
+    }
+}
+
 class QuaternionMatrix Quaternion::toMatrix() {
-    return QuaternionMatrix(
+    QuaternionMatrix matrix = QuaternionMatrix(
             a, -b, -c, -d,
             b, a, -d, c,
             c, d, a, -b,
             d, -c, b, a
     );
+
+    return matrix;
 }
 
 class RotationMatrix Quaternion::getRotationMatrix() {
@@ -93,12 +195,300 @@ class RotationMatrix Quaternion::getRotationMatrix() {
     );
 }
 
+// Matrices converted per block by the batch conversions. A RotationMatrix is 9 doubles, which compilers
+// cannot load or store as interleaved vectors, so each block goes through one array per coefficient.
+static const size_t CONVERSION_BLOCK = 64;
+
+// Same result as getRotationMatrix. The arithmetic loop works on the coefficient arrays so it can be vectorized,
+// the second loop only copies them into the matrices.
+void Quaternion::toRotationMatrices(const Quaternion* quaternions, RotationMatrix* out, size_t count) {
+    double coefficients[9][CONVERSION_BLOCK];
+
+    for (size_t start = 0; start < count; start += CONVERSION_BLOCK) {
+        size_t length = count - start < CONVERSION_BLOCK ? count - start : CONVERSION_BLOCK;
+        const Quaternion* block = quaternions + start;
+
+        for (size_t i = 0; i < length; ++i) {
+            const Quaternion& q = block[i];
+            double invNorm = 1 / sqrt(q.a * q.a + q.b * q.b + q.c * q.c + q.d * q.d);
+            double a = q.a * invNorm;
+            double b = q.b * invNorm;
+            double c = -q.c * invNorm;
+            double d = q.d * invNorm;
+
+            coefficients[0][i] = 1 - 2*c*c - 2*d*d; coefficients[1][i] = 2*b*c - 2*d*a;     coefficients[2][i] = 2*b*d + 2*c*a;
+            coefficients[3][i] = 2*b*c + 2*d*a;     coefficients[4][i] = 1 - 2*b*b - 2*d*d; coefficients[5][i] = 2*c*d - 2*b*a;
+            coefficients[6][i] = 2*b*d - 2*c*a;     coefficients[7][i] = 2*c*d + 2*b*a;     coefficients[8][i] = 1 - 2*b*b - 2*c*c;
+        }
+
+        RotationMatrix* matrices = out + start;
+        for (size_t i = 0; i < length; ++i) {
+            RotationMatrix& m = matrices[i];
+            m.a1 = coefficients[0][i]; m.a2 = coefficients[1][i]; m.a3 = coefficients[2][i];
+            m.b1 = coefficients[3][i]; m.b2 = coefficients[4][i]; m.b3 = coefficients[5][i];
+            m.c1 = coefficients[6][i]; m.c2 = coefficients[7][i]; m.c3 = coefficients[8][i];
+        }
+    }
+}
+
+// Minimum chain length per thread, below that spawning threads costs more than it saves
+static const size_t COMPOSE_CHUNK = 1 << 16;
+
+// Sequential product of a range. The range is cut in 4 consecutive parts multiplied side by side,
+// so 4 independent products are in flight instead of one long dependency chain.
+static Quaternion composeRange(const Quaternion* quaternions, size_t count, size_t renormalizeInterval) {
+    Quaternion lanes[4] = {{1, 0, 0, 0}, {1, 0, 0, 0}, {1, 0, 0, 0}, {1, 0, 0, 0}};
+    size_t laneLength = count / 4;
+
+    for (size_t i = 0; i < laneLength; ++i) {
+        for (int lane = 0; lane < 4; ++lane)
+            lanes[lane] = lanes[lane].multiply(quaternions[lane * laneLength + i]);
+
+        if (renormalizeInterval != 0 && (i + 1) % renormalizeInterval == 0) {
+            for (int lane = 0; lane < 4; ++lane)
+                lanes[lane] = lanes[lane].getUnit();
+        }
+    }
+
+    // Leftovers belong at the end of the last part
+    for (size_t i = laneLength * 4; i < count; ++i)
+        lanes[3] = lanes[3].multiply(quaternions[i]);
+
+    Quaternion result = lanes[0].multiply(lanes[1]).multiply(lanes[2]).multiply(lanes[3]);
+    return renormalizeInterval != 0 ? result.getUnit() : result;
+}
+
+Quaternion Quaternion::composeAll(const Quaternion* quaternions, size_t count, size_t renormalizeInterval,
+                                  FrameArena* scratch) {
+    size_t workerCount = getWorkerCount(count, COMPOSE_CHUNK);
+    std::vector<Quaternion> storage;
+    Quaternion* partials = allocateScratch(scratch, storage, workerCount, Quaternion(1, 0, 0, 0));
+
+    parallelRanges(count, workerCount, [&](size_t worker, size_t begin, size_t end) {
+        partials[worker] = composeRange(quaternions + begin, end - begin, renormalizeInterval);
+    });
+
+    // Multiplication is not commutative, the partial products are combined in chain order
+    Quaternion result = Quaternion(1, 0, 0, 0);
+    for (size_t worker = 0; worker < workerCount; ++worker)
+        result = result.multiply(partials[worker]);
+
+    return renormalizeInterval != 0 && count != 0 ? result.getUnit() : result;
+}
+
+void Quaternion::composeScan(const Quaternion* quaternions, Quaternion* out, size_t count, size_t renormalizeInterval,
+                             FrameArena* scratch) {
+    size_t workerCount = getWorkerCount(count, COMPOSE_CHUNK);
+
+    // Pass 1: local scan of each slice
+    parallelRanges(count, workerCount, [&](size_t, size_t begin, size_t end) {
+        Quaternion running = Quaternion(1, 0, 0, 0);
+        for (size_t i = begin; i < end; ++i) {
+            running = running.multiply(quaternions[i]);
+            if (renormalizeInterval != 0 && (i - begin + 1) % renormalizeInterval == 0)
+                running = running.getUnit();
+            out[i] = running;
+        }
+    });
+
+    if (workerCount <= 1)
+        return;
+
+    // Pass 2: product of everything before each slice
+    std::vector<Quaternion> storage;
+    Quaternion* offsets = allocateScratch(scratch, storage, workerCount, Quaternion(1, 0, 0, 0));
+    for (size_t worker = 1; worker < workerCount; ++worker) {
+        size_t previousEnd = count * worker / workerCount;
+        offsets[worker] = offsets[worker - 1].multiply(out[previousEnd - 1]);
+        if (renormalizeInterval != 0)
+            offsets[worker] = offsets[worker].getUnit();
+    }
+
+    // Pass 3: prepend that product to every element of the slice
+    parallelRanges(count, workerCount, [&](size_t worker, size_t begin, size_t end) {
+        if (worker == 0)
+            return;
+        for (size_t i = begin; i < end; ++i)
+            out[i] = offsets[worker].multiply(out[i]);
+    });
+}
+
+// Samples per thread for the averaging passes
+static const size_t AVERAGE_CHUNK = 1 << 15;
+
+// Eigenvector of the largest eigenvalue of a symmetric 4x4 matrix, cyclic Jacobi rotations
+static void largestEigenvector(double matrix[4][4], double vector[4]) {
+    double vectors[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+
+    for (int sweep = 0; sweep < 50; ++sweep) {
+        double offDiagonal = 0;
+        double diagonal = 0;
+        for (int p = 0; p < 4; ++p) {
+            diagonal += matrix[p][p] * matrix[p][p];
+            for (int q = p + 1; q < 4; ++q)
+                offDiagonal += matrix[p][q] * matrix[p][q];
+        }
+        // Relative to the diagonal, the sums scale with the number and weights of the samples:
+        // stop once the off-diagonal part is at rounding level (1e-15 in magnitude)
+        if (offDiagonal <= 1e-30 * diagonal)
+            break;
+
+        for (int p = 0; p < 4; ++p) {
+            for (int q = p + 1; q < 4; ++q) {
+                if (matrix[p][q] == 0)
+                    continue;
+
+                double theta = (matrix[q][q] - matrix[p][p]) / (2 * matrix[p][q]);
+                double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+                double cosine = 1 / sqrt(t * t + 1);
+                double sine = t * cosine;
+
+                for (int k = 0; k < 4; ++k) {
+                    double kp = matrix[k][p];
+                    double kq = matrix[k][q];
+                    matrix[k][p] = cosine * kp - sine * kq;
+                    matrix[k][q] = sine * kp + cosine * kq;
+                }
+                for (int k = 0; k < 4; ++k) {
+                    double pk = matrix[p][k];
+                    double qk = matrix[q][k];
+                    matrix[p][k] = cosine * pk - sine * qk;
+                    matrix[q][k] = sine * pk + cosine * qk;
+                }
+                for (int k = 0; k < 4; ++k) {
+                    double kp = vectors[k][p];
+                    double kq = vectors[k][q];
+                    vectors[k][p] = cosine * kp - sine * kq;
+                    vectors[k][q] = sine * kp + cosine * kq;
+                }
+            }
+        }
+    }
+
+    int largest = 0;
+    for (int i = 1; i < 4; ++i)
+        if (matrix[i][i] > matrix[largest][largest])
+            largest = i;
+
+    for (int k = 0; k < 4; ++k)
+        vector[k] = vectors[k][largest];
+}
+
+Quaternion Quaternion::average(const Quaternion* quaternions, const double* weights, size_t count, FrameArena* scratch) {
+    if (count == 0)
+        return {1, 0, 0, 0};
+
+    // Upper triangle of sum(w q q^T), one copy per thread
+    size_t workerCount = getWorkerCount(count, AVERAGE_CHUNK);
+    std::vector<double> storage;
+    double* sums = allocateScratch(scratch, storage, workerCount * 10, 0.0);
+
+    parallelRanges(count, workerCount, [&](size_t worker, size_t begin, size_t end) {
+        double aa = 0, ab = 0, ac = 0, ad = 0, bb = 0, bc = 0, bd = 0, cc = 0, cd = 0, dd = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const Quaternion& q = quaternions[i];
+            double w = weights != nullptr ? weights[i] : 1;
+            aa += w * q.a * q.a; ab += w * q.a * q.b; ac += w * q.a * q.c; ad += w * q.a * q.d;
+            bb += w * q.b * q.b; bc += w * q.b * q.c; bd += w * q.b * q.d;
+            cc += w * q.c * q.c; cd += w * q.c * q.d;
+            dd += w * q.d * q.d;
+        }
+
+        double* sum = &sums[worker * 10];
+        sum[0] = aa; sum[1] = ab; sum[2] = ac; sum[3] = ad; sum[4] = bb;
+        sum[5] = bc; sum[6] = bd; sum[7] = cc; sum[8] = cd; sum[9] = dd;
+    });
+
+    double total[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    for (size_t worker = 0; worker < workerCount; ++worker)
+        for (int k = 0; k < 10; ++k)
+            total[k] += sums[worker * 10 + k];
+
+    double matrix[4][4] = {
+            {total[0], total[1], total[2], total[3]},
+            {total[1], total[4], total[5], total[6]},
+            {total[2], total[5], total[7], total[8]},
+            {total[3], total[6], total[8], total[9]}
+    };
+
+    double vector[4];
+    largestEigenvector(matrix, vector);
+
+    // Either sign is the same orientation, keep the scalar part positive
+    double sign = vector[0] < 0 ? -1 : 1;
+    return Quaternion(sign * vector[0], sign * vector[1], sign * vector[2], sign * vector[3]).getUnit();
+}
+
+Quaternion Quaternion::geodesicAverage(const Quaternion* quaternions, const double* weights, size_t count,
+                                       int maxIterations, double tolerance, FrameArena* scratch) {
+    Quaternion mean = average(quaternions, weights, count, scratch);
+    if (count == 0)
+        return mean;
+
+    size_t workerCount = getWorkerCount(count, AVERAGE_CHUNK);
+    std::vector<double> storage;
+    double* sums = allocateScratch(scratch, storage, workerCount * 4, 0.0);
+
+    for (int iteration = 0; iteration < maxIterations; ++iteration) {
+        Quaternion inverse = mean.conjugate();
+
+        // Weighted mean of the samples in the tangent space at the current mean
+        parallelRanges(count, workerCount, [&](size_t worker, size_t begin, size_t end) {
+            double x = 0, y = 0, z = 0, weightSum = 0;
+            for (size_t i = begin; i < end; ++i) {
+                Quaternion offset = inverse.multiply(quaternions[i]);
+                // Shortest arc: flip to the hemisphere of the mean
+                double sign = offset.a < 0 ? -1 : 1;
+                Quaternion tangent = Quaternion();
+                logValues(sign * offset.a, sign * offset.b, sign * offset.c, sign * offset.d, tangent);
+
+                double w = weights != nullptr ? weights[i] : 1;
+                x += w * tangent.b;
+                y += w * tangent.c;
+                z += w * tangent.d;
+                weightSum += w;
+            }
+
+            double* sum = &sums[worker * 4];
+            sum[0] = x; sum[1] = y; sum[2] = z; sum[3] = weightSum;
+        });
+
+        double x = 0, y = 0, z = 0, weightSum = 0;
+        for (size_t worker = 0; worker < workerCount; ++worker) {
+            x += sums[worker * 4];
+            y += sums[worker * 4 + 1];
+            z += sums[worker * 4 + 2];
+            weightSum += sums[worker * 4 + 3];
+        }
+        if (weightSum == 0)
+            break;
+
+        Quaternion step = Quaternion(0, x / weightSum, y / weightSum, z / weightSum);
+        mean = mean.multiply(step.exp()).getUnit();
+
+        if (2 * sqrt(step.b * step.b + step.c * step.c + step.d * step.d) < tolerance)
+            break;
+    }
+
+    return mean;
+}
+
 Double3 Quaternion::crossProduct(const Quaternion &other) {
     return Double3(b, c, d).crossProduct(Double3(other.b, other.c, other.d));
 }
 
 // ----- MATRIX -----
 
+// Coefficients in row-major order, for indexed access without treating the fields as an array
+static double QuaternionMatrix::* const QUATERNION_MATRIX_FIELDS[16] = {
+        &QuaternionMatrix::a1, &QuaternionMatrix::a2, &QuaternionMatrix::a3, &QuaternionMatrix::a4,
+        &QuaternionMatrix::b1, &QuaternionMatrix::b2, &QuaternionMatrix::b3, &QuaternionMatrix::b4,
+        &QuaternionMatrix::c1, &QuaternionMatrix::c2, &QuaternionMatrix::c3, &QuaternionMatrix::c4,
+        &QuaternionMatrix::d1, &QuaternionMatrix::d2, &QuaternionMatrix::d3, &QuaternionMatrix::d4
+};
+
+static_assert(sizeof(QuaternionMatrix) == 16 * sizeof(double), "QuaternionMatrix must be 16 packed doubles");
+
 // ugly constructor
 QuaternionMatrix::QuaternionMatrix(
         double a1, double a2, double a3, double a4,
@@ -115,34 +505,57 @@ QuaternionMatrix QuaternionMatrix::multiply(double x) {
             a1 * x, a2 * x, a3 * x, a4 * x,
             b1 * x, b2 * x, b3 * x, b4 * x,
             c1 * x, c2 * x, c3 * x, c4 * x,
-            d1 * x, d2 * x, d3 * x, d4 * x,
+            d1 * x, d2 * x, d3 * x, d4 * x
     };
 }
 
-QuaternionMatrix QuaternionMatrix::multiply(QuaternionMatrix other) {
+QuaternionMatrix QuaternionMatrix::multiply(const QuaternionMatrix &other) {
+    // Fast path: L(p) * L(q) = L(p * q), 16 multiplications instead of 64
+    if (isQuaternionForm() && other.isQuaternionForm())
+        return toQuaternion().multiply(Quaternion(other.a1, other.b1, other.c1, other.d1)).toMatrix();
+
+    // General case: each result row is a linear combination of the rows of other,
+    // the inner loop works on whole rows so it maps onto SIMD registers
+    const double left[16] = {a1, a2, a3, a4, b1, b2, b3, b4, c1, c2, c3, c4, d1, d2, d3, d4};
+    const double right[16] = {
+            other.a1, other.a2, other.a3, other.a4, other.b1, other.b2, other.b3, other.b4,
+            other.c1, other.c2, other.c3, other.c4, other.d1, other.d2, other.d3, other.d4
+    };
+
+    double sum[16] = {};
+    for (int row = 0; row < 4; ++row) {
+        for (int k = 0; k < 4; ++k) {
+            double factor = left[row * 4 + k];
+            for (int column = 0; column < 4; ++column)
+                sum[row * 4 + column] += factor * right[k * 4 + column];
+        }
+    }
+
     return {
-            a1 * other.a1 + a2 * other.b1 + a3 * other.c1 + a4 * other.d1,
-            a1 * other.a2 + a2 * other.b2 + a3 * other.c2 + a4 * other.d2,
-            a1 * other.a3 + a2 * other.b3 + a3 * other.c3 + a4 * other.d3,
-            a1 * other.a4 + a2 * other.b4 + a3 * other.c4 + a4 * other.d4,
-
-            b1 * other.a1 + b2 * other.b1 + b3 * other.c1 + b4 * other.d1,
-            b1 * other.a2 + b2 * other.b2 + b3 * other.c2 + b4 * other.d2,
-            b1 * other.a3 + b2 * other.b3 + b3 * other.c3 + b4 * other.d3,
-            b1 * other.a4 + b2 * other.b4 + b3 * other.c4 + b4 * other.d4,
-
-            c1 * other.a1 + c2 * other.b1 + c3 * other.c1 + c4 * other.d1,
-            c1 * other.a2 + c2 * other.b2 + c3 * other.c2 + c4 * other.d2,
-            c1 * other.a3 + c2 * other.b3 + c3 * other.c3 + c4 * other.d3,
-            c1 * other.a4 + c2 * other.b4 + c3 * other.c4 + c4 * other.d4,
-
-            d1 * other.a1 + d2 * other.b1 + d3 * other.c1 + d4 * other.d1,
-            d1 * other.a2 + d2 * other.b2 + d3 * other.c2 + d4 * other.d2,
-            d1 * other.a3 + d2 * other.b3 + d3 * other.c3 + d4 * other.d3,
-            d1 * other.a4 + d2 * other.b4 + d3 * other.c4 + d4 * other.d4
+            sum[0], sum[1], sum[2], sum[3],
+            sum[4], sum[5], sum[6], sum[7],
+            sum[8], sum[9], sum[10], sum[11],
+            sum[12], sum[13], sum[14], sum[15]
     };
 }
 
+double QuaternionMatrix::at(int row, int column) const {
+    return this->*QUATERNION_MATRIX_FIELDS[row * 4 + column];
+}
+
+void QuaternionMatrix::set(int row, int column, double value) {
+    this->*QUATERNION_MATRIX_FIELDS[row * 4 + column] = value;
+}
+
+// Checked from the values rather than remembered, so it can never disagree with them:
+// 12 comparisons against the layout of toMatrix(), cheap next to the 64 products of the general case
+bool QuaternionMatrix::isQuaternionForm() const {
+    return b2 == a1 && c3 == a1 && d4 == a1
+           && a2 == -b1 && a3 == -c1 && a4 == -d1
+           && b3 == -d1 && b4 == c1 && c2 == d1
+           && c4 == -b1 && d2 == -c1 && d3 == b1;
+}
+
 Quaternion QuaternionMatrix::toQuaternion() {
     return {a1, b1, c1, d1};
 }
@@ -214,6 +627,69 @@ Quaternion RotationMatrix::toQuaternion() {
     return q.multiply(0.5 / sqrt(t));
 }
 
+// 1.0 when x < 0, 0.0 otherwise. Built from the sign bit with integer operations: compilers keep float
+// comparisons as branches (they may trap), which stops the loops using this from being vectorized.
+static inline double negativeWeight(double x) {
+    // -0.0 becomes +0.0, which is not negative
+    x += 0.0;
+
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    bits = (0 - (bits >> 63)) & 0x3FF0000000000000ull;
+    memcpy(&x, &bits, sizeof(x));
+
+    return x;
+}
+
+// Same result as toQuaternion. Every case is computed and the right one is kept through 0/1 weights,
+// so there is no branch and the arithmetic loop can be vectorized.
+void RotationMatrix::toQuaternions(const RotationMatrix* matrices, Quaternion* out, size_t count) {
+    double coefficients[9][CONVERSION_BLOCK];
+
+    for (size_t start = 0; start < count; start += CONVERSION_BLOCK) {
+        size_t length = count - start < CONVERSION_BLOCK ? count - start : CONVERSION_BLOCK;
+        const RotationMatrix* block = matrices + start;
+
+        for (size_t i = 0; i < length; ++i) {
+            const RotationMatrix& m = block[i];
+            coefficients[0][i] = m.a1; coefficients[1][i] = m.a2; coefficients[2][i] = m.a3;
+            coefficients[3][i] = m.b1; coefficients[4][i] = m.b2; coefficients[5][i] = m.b3;
+            coefficients[6][i] = m.c1; coefficients[7][i] = m.c2; coefficients[8][i] = m.c3;
+        }
+
+        Quaternion* quaternions = out + start;
+        for (size_t i = 0; i < length; ++i) {
+            double a1 = coefficients[0][i], a2 = coefficients[1][i], a3 = coefficients[2][i];
+            double b1 = coefficients[3][i], b2 = coefficients[4][i], b3 = coefficients[5][i];
+            double c1 = coefficients[6][i], c2 = coefficients[7][i], c3 = coefficients[8][i];
+
+            // Weights of the four cases of toQuaternion, exactly one of them is 1
+            double negativeC3 = negativeWeight(c3);
+            double w0 = negativeC3 * negativeWeight(b2 - a1);        // c3 < 0 and a1 > b2
+            double w1 = negativeC3 - w0;                             // c3 < 0 and a1 <= b2
+            double w2 = (1 - negativeC3) * negativeWeight(a1 + b2);  // c3 >= 0 and a1 < -b2
+            double w3 = 1 - negativeC3 - w2;                         // c3 >= 0 and a1 >= -b2
+
+            double t0 = 1 + a1 - b2 - c3;
+            double t1 = 1 - a1 + b2 - c3;
+            double t2 = 1 - a1 - b2 + c3;
+            double t3 = 1 + a1 + b2 + c3;
+
+            double t = w0 * t0 + w1 * t1 + w2 * t2 + w3 * t3;
+            double a = w0 * t0 + w1 * (a2 + b1) + w2 * (c1 + a3) + w3 * (b3 - c2);
+            double b = w0 * (a2 + b1) + w1 * t1 + w2 * (b3 + c2) + w3 * (c1 - a3);
+            double c = w0 * (c1 + a3) + w1 * (b3 + c2) + w2 * t2 + w3 * (a2 - b1);
+            double d = w0 * (b3 - c2) + w1 * (c1 - a3) + w2 * (a2 - b1) + w3 * t3;
+
+            double scale = 0.5 / sqrt(t);
+            quaternions[i].a = a * scale;
+            quaternions[i].b = b * scale;
+            quaternions[i].c = c * scale;
+            quaternions[i].d = d * scale;
+        }
+    }
+}
+
 // ----- DOUBLE 3 -----
 
 Double3::Double3() {}
@@ -259,7 +735,7 @@ Double3 Double3::rotate(const Quaternion &quaternion, Double3 origin) {
     // Calcul du résultat
     Quaternion temp = quaternion;
     temp = temp.getUnit();
-    Quaternion result = temp.multiply(Quaternion(0, tempPoint.x, tempPoint.y, tempPoint.z)).multiply(temp.conjugate());
+    Quaternion result = temp * Quaternion(0, tempPoint.x, tempPoint.y, tempPoint.z) * ~temp;
 
     // Remettre à l'origine
     return Double3(result.b + origin.x, result.d + origin.y, result.c + origin.z);
@@ -1,6 +1,10 @@
 #ifndef QUATERNION_LIBRARY_H
 #define QUATERNION_LIBRARY_H
 
+#include <cstddef>
+
+struct FrameArena;
+
 struct Quaternion
 {
 public:
@@ -18,16 +22,49 @@ public:
 
     static Quaternion eulerAngles(double rads, Double3 axis);
 
+    Quaternion exp();
+    Quaternion log();
+    Quaternion pow(double t);
+
     class QuaternionMatrix toMatrix();
     class RotationMatrix getRotationMatrix();
 
+    // Batch versions of exp, log and pow, out must hold count quaternions
+    static void expAll(const Quaternion* quaternions, Quaternion* out, size_t count);
+    static void logAll(const Quaternion* quaternions, Quaternion* out, size_t count);
+    static void powAll(const Quaternion* quaternions, double t, Quaternion* out, size_t count);
+
+    // The batch functions below keep their per-thread partial results in scratch when it is given,
+    // so calls made every frame do not touch the heap (apart from the threads of large batches).
+
+    // Weighted average orientation (Markley): eigenvector of the largest eigenvalue of sum(w q q^T), computed in
+    // one parallel pass. q and -q count as the same orientation. weights may be nullptr for equal weights.
+    static Quaternion average(const Quaternion* quaternions, const double* weights, size_t count,
+                              FrameArena* scratch = nullptr);
+    // Weighted geodesic (Karcher) mean, refined from average() until the update is below tolerance radians
+    static Quaternion geodesicAverage(const Quaternion* quaternions, const double* weights, size_t count,
+                                      int maxIterations = 16, double tolerance = 1e-12, FrameArena* scratch = nullptr);
+
+    // Batch version of getRotationMatrix, out must hold count matrices
+    static void toRotationMatrices(const Quaternion* quaternions, class RotationMatrix* out, size_t count);
+
+    // Product quaternions[0] * quaternions[1] * ... * quaternions[count - 1], reduced across threads.
+    // Partial products are renormalized every renormalizeInterval steps to stop drift (inputs must then be unit
+    // quaternions), 0 disables it. An empty chain gives the identity.
+    static Quaternion composeAll(const Quaternion* quaternions, size_t count, size_t renormalizeInterval = 64,
+                                 FrameArena* scratch = nullptr);
+    // Inclusive scan of the same chain: out[i] = quaternions[0] * ... * quaternions[i]
+    static void composeScan(const Quaternion* quaternions, Quaternion* out, size_t count, size_t renormalizeInterval = 64,
+                            FrameArena* scratch = nullptr);
+
 private:
     Quaternion();
 };
 
-struct QuaternionMatrix
+struct alignas(32) QuaternionMatrix
 {
 public:
+    // Row-major and contiguous (128 bytes, 32-byte aligned), at() and set() index them as an array
     double a1, a2, a3, a4;
     double b1, b2, b3, b4;
     double c1, c2, c3, c4;
@@ -37,7 +74,14 @@ public:
                      double c3, double c4, double d1, double d2, double d3, double d4);
 
     QuaternionMatrix multiply(double x);
-    QuaternionMatrix multiply(QuaternionMatrix other);
+    QuaternionMatrix multiply(const QuaternionMatrix& other);
+
+    double at(int row, int column) const;
+    void set(int row, int column, double value);
+
+    // True when the matrix is the left-multiplication matrix of a quaternion (see Quaternion::toMatrix),
+    // the product of two such matrices is then computed as a quaternion product
+    bool isQuaternionForm() const;
 
     Quaternion toQuaternion();
 
@@ -59,6 +103,9 @@ public:
 
     Quaternion toQuaternion();
 
+    // Batch version of toQuaternion, out must hold count quaternions
+    static void toQuaternions(const RotationMatrix* matrices, Quaternion* out, size_t count);
+
 private:
     RotationMatrix();
 };
@@ -8,9 +8,16 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include "library.h"
+#include "arena.h"
+#include "quaternion_expr.h"
+#include "frame_pipeline.h"
 
 const GLint WINDOW_WIDTH = 800, WINDOW_HEIGHT = 600;
 const GLfloat MOUSE_SENSITIVITY = .001f;
+// NOTE: Frames the model transform may lag behind the render thread (0 = serial, 1 = double buffered, 2 = triple buffered)
+const int FRAME_LATENCY = 1;
+// NOTE: How fast the displayed camera orientation catches up with the input, per second (higher = snappier)
+const float CAMERA_SMOOTHING_RATE = 20.0f;
 
 // NOTE: Vertex Shader source code
 const char* vertexShaderSource = R"(
@@ -146,8 +153,12 @@ void applyRotationWithQuaternion(Quaternion& q, GLfloat* vertices, int vertexCou
     }
 }
 
-std::vector<Vertex> applyRotationWithQuaternion(Quaternion& q, std::vector<Vertex> vertices, Double3 origin = Double3(0, 0, 0)) {
-    std::vector<Vertex> newVector;
+typedef std::vector<Vertex, ArenaAllocator<Vertex>> FrameVertices;
+
+// NOTE: The result lives in the frame arena and is only valid until the arena is reset
+FrameVertices applyRotationWithQuaternion(Quaternion& q, const std::vector<Vertex>& vertices, FrameArena& arena, Double3 origin = Double3(0, 0, 0)) {
+    FrameVertices newVector = FrameVertices(ArenaAllocator<Vertex>(arena));
+    newVector.reserve(vertices.size());
     for (int i = 0; i < vertices.size(); ++i)
     {
         Double3 vertex(vertices[i].position[0], vertices[i].position[1], vertices[i].position[2]);
@@ -165,6 +176,37 @@ std::vector<Vertex> applyRotationWithQuaternion(Quaternion& q, std::vector<Verte
     return newVector;
 }
 
+// NOTE: One frame of model transform, computed by the pipeline worker while the render thread draws
+struct ModelFrame {
+    Quaternion rotation = Quaternion(1, 0, 0, 0);
+    Double3 origin = Double3(0, 0, 0);
+    FrameArena arena;
+    FrameVertices vertices = FrameVertices(ArenaAllocator<Vertex>(arena));
+
+    explicit ModelFrame(size_t arenaCapacity) : arena(arenaCapacity) {}
+};
+
+void computeModelFrame(ModelFrame& frame) {
+    // NOTE: Release the previous result of this slot, report when its arena had to fall back to the heap
+    FrameArenaStats arenaStats = frame.arena.getStats();
+    if (arenaStats.heapAllocations != 0)
+        printf("Frame arena hit the heap %zu time(s) (peak %zu bytes)\n", arenaStats.heapAllocations, arenaStats.peakBytes);
+    frame.arena.reset();
+
+    frame.vertices = applyRotationWithQuaternion(frame.rotation, modelVertices, frame.arena, frame.origin);
+}
+
+// NOTE: Moves current toward target along the shortest arc, the same amount of smoothing whatever the frame rate
+Quaternion smoothOrientation(Quaternion current, Quaternion target, float deltaTime) {
+    Quaternion delta = ~current * target;
+    if (delta.a < 0)
+        delta = delta.multiply(-1);
+
+    double t = 1 - exp(-CAMERA_SMOOTHING_RATE * deltaTime);
+    Quaternion smoothed = current * delta.pow(t);
+    return smoothed.getUnit();
+}
+
 void applyRotationWithMatrix(Quaternion& q, GLfloat* matrix) {
     RotationMatrix quaternionMatrix = q.getRotationMatrix();
     matrix[0] = quaternionMatrix.a1; matrix[1] = quaternionMatrix.a2; matrix[2] = quaternionMatrix.a3;
@@ -384,8 +426,15 @@ int main() {
     Double3 centerPosition = Double3(0, 0, 0);
     float centeredOffset = 5;
 
+    // NOTE: The model is transformed on a worker thread, overlapping with the submission of the previous frame
+    // NOTE: Each frame arena fits the transformed model from the start, so no frame ever falls back to the heap
+    FramePipeline<ModelFrame> modelPipeline(FRAME_LATENCY, computeModelFrame, modelVertices.size() * sizeof(Vertex) + 4096);
+
+    Quaternion smoothedRotation = Quaternion(1, 0, 0, 0);
+    Quaternion smoothedCameraRotation = Quaternion(1, 0, 0, 0);
+
     // NOTE: Loop until the user closes the window or press esc
-    float timeValue;
+    float timeValue = (float)glfwGetTime();
     while (!glfwWindowShouldClose(window) && glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS) {
         glfwSetCursorPos(window, WINDOW_WIDTH / 2,  WINDOW_HEIGHT / 2);
 
@@ -395,9 +444,10 @@ int main() {
         float deltaTime = timeValue - previousTime;
         float angle = timeValue * M_PI / 4; // NOTE: Rotate 45 degrees per second
 
-        Quaternion q_rotation = Quaternion::eulerAngles(cameraPitch, Double3(1, 0, 0)).multiply(Quaternion::eulerAngles(cameraYaw, Double3(0, 1, 0)));
+        Quaternion q_rotation = Quaternion::eulerAngles(cameraPitch, Double3(1, 0, 0)) * Quaternion::eulerAngles(cameraYaw, Double3(0, 1, 0));
         // NOTE: Compose rotations
-        Quaternion q_composed = q_rotation.getUnit();
+        smoothedRotation = smoothOrientation(smoothedRotation, q_rotation.getUnit(), deltaTime);
+        Quaternion q_composed = smoothedRotation;
 
         // Camera Controls
         if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
@@ -415,9 +465,10 @@ int main() {
         if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS)
             cameraYaw -= M_PI * deltaTime;
 
-        Quaternion q_rotationCamera = Quaternion::eulerAngles(cameraYaw, Double3(0, 0, 1)).multiply(Quaternion::eulerAngles(cameraPitch, Double3(1, 0, 0)));
+        Quaternion q_rotationCamera = Quaternion::eulerAngles(cameraYaw, Double3(0, 0, 1)) * Quaternion::eulerAngles(cameraPitch, Double3(1, 0, 0));
         // NOTE: Compose rotations
-        Quaternion q_composedCamera = q_rotationCamera.getUnit();
+        smoothedCameraRotation = smoothOrientation(smoothedCameraRotation, q_rotationCamera.getUnit(), deltaTime);
+        Quaternion q_composedCamera = smoothedCameraRotation;
 
         if (centeredCamera)
         {
@@ -460,7 +511,11 @@ int main() {
         Quaternion cubeAnimationRotation = Quaternion::eulerAngles(angle, {0, 1, 1});
         applyRotationWithQuaternion(cubeAnimationRotation, vertices, sizeof(vertices) / sizeof(vertices[0]));
         applyRotationWithQuaternion(q_composed, vertices, sizeof(vertices) / sizeof(vertices[0]), Double3(-cameraTranslation.x, 5 - cameraTranslation.z,  (1 + sin(timeValue)) -cameraTranslation.y));
-        std::vector<Vertex> rotatedModelVertices = applyRotationWithQuaternion(q_composed, modelVertices, Double3(-2 -cameraTranslation.x, -cameraTranslation.z, 1 -cameraTranslation.y));
+
+        ModelFrame& nextModelFrame = modelPipeline.acquire();
+        nextModelFrame.rotation = q_composed;
+        nextModelFrame.origin = Double3(-2 -cameraTranslation.x, -cameraTranslation.z, 1 -cameraTranslation.y);
+        modelPipeline.submit(nextModelFrame);
 
         // NOTE: Apply translations
         applyTranslation(0.0f, 1 + sin(timeValue), -5.0f, matrix1);
@@ -470,9 +525,13 @@ int main() {
         glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-        // Update the vertices of the tree model
-        glBindBuffer(GL_ARRAY_BUFFER, VBO[2]);
-        glBufferData(GL_ARRAY_BUFFER, rotatedModelVertices.size() * sizeof(Vertex), &rotatedModelVertices[0], GL_STATIC_DRAW);
+        // Update the vertices of the tree model with the oldest finished transform, FRAME_LATENCY frames behind
+        if (modelPipeline.isBehind()) {
+            ModelFrame& modelFrame = modelPipeline.waitCompleted();
+            glBindBuffer(GL_ARRAY_BUFFER, VBO[2]);
+            glBufferData(GL_ARRAY_BUFFER, modelFrame.vertices.size() * sizeof(Vertex), &modelFrame.vertices[0], GL_STATIC_DRAW);
+            modelPipeline.release(modelFrame);
+        }
 
         // NOTE: Clear the colorbuffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -0,0 +1,330 @@
+#include "orientation_index.h"
+#include "arena.h"
+#include "parallel.h"
+#include "quaternion_stream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Queries per thread below which batched queries stay on the calling thread
+static const size_t ORIENTATION_QUERIES_PER_WORKER = 256;
+
+static const char ORIENTATION_INDEX_MAGIC[4] = {'Q', 'O', 'R', 'I'};
+static const uint32_t ORIENTATION_INDEX_VERSION = 2;
+
+static bool closerMatch(const OrientationMatch& left, const OrientationMatch& right) {
+    return left.angle < right.angle;
+}
+
+static void normalizeInto(const Quaternion& q, double* out) {
+    double invNorm = 1 / sqrt(q.a * q.a + q.b * q.b + q.c * q.c + q.d * q.d);
+    out[0] = q.a * invNorm;
+    out[1] = q.b * invNorm;
+    out[2] = q.c * invNorm;
+    out[3] = q.d * invNorm;
+}
+
+static double angleFromDot(double dot) {
+    dot = fabs(dot);
+    return 2 * acos(dot < 1 ? dot : 1);
+}
+
+OrientationIndex::OrientationIndex() {}
+
+double OrientationIndex::angleBetween(const Quaternion& p, const Quaternion& q) {
+    double left[4], right[4];
+    normalizeInto(p, left);
+    normalizeInto(q, right);
+    return angleFromDot(left[0] * right[0] + left[1] * right[1] + left[2] * right[2] + left[3] * right[3]);
+}
+
+size_t OrientationIndex::size() const {
+    return ids.size();
+}
+
+double OrientationIndex::distanceTo(size_t point, const double* query) const {
+    const double* p = &points[point * 4];
+    return angleFromDot(p[0] * query[0] + p[1] * query[1] + p[2] * query[2] + p[3] * query[3]);
+}
+
+// ----- BUILD -----
+
+void OrientationIndex::build(const Quaternion* orientations, size_t count) {
+    points.resize(count * 4);
+    ids.resize(count);
+    nodes.resize(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        normalizeInto(orientations[i], &points[i * 4]);
+        ids[i] = i;
+    }
+
+    buildRange(0, count);
+}
+
+void OrientationIndex::buildRange(size_t begin, size_t end) {
+    if (begin >= end)
+        return;
+
+    Node& node = nodes[begin];
+    if (end - begin == 1) {
+        node.threshold = 0;
+        node.insideEnd = end;
+        return;
+    }
+
+    // The middle point of the range is as good a vantage point as any and keeps the build deterministic
+    size_t vantage = begin + (end - begin) / 2;
+    std::swap_ranges(&points[begin * 4], &points[begin * 4] + 4, &points[vantage * 4]);
+    std::swap(ids[begin], ids[vantage]);
+
+    // Order the rest by distance to the vantage point through a permutation, then apply it
+    std::vector<std::pair<double, size_t>> distances;
+    distances.reserve(end - begin - 1);
+    for (size_t i = begin + 1; i < end; ++i)
+        distances.emplace_back(distanceTo(i, &points[begin * 4]), i);
+
+    size_t median = distances.size() / 2;
+    std::nth_element(distances.begin(), distances.begin() + median, distances.end());
+
+    std::vector<double> reorderedPoints(distances.size() * 4);
+    std::vector<uint64_t> reorderedIds(distances.size());
+    for (size_t i = 0; i < distances.size(); ++i) {
+        memcpy(&reorderedPoints[i * 4], &points[distances[i].second * 4], 4 * sizeof(double));
+        reorderedIds[i] = ids[distances[i].second];
+    }
+    std::copy(reorderedPoints.begin(), reorderedPoints.end(), points.begin() + (begin + 1) * 4);
+    std::copy(reorderedIds.begin(), reorderedIds.end(), ids.begin() + begin + 1);
+
+    size_t insideEnd = begin + 1 + median;
+    node.threshold = distances[median].first;
+    node.insideEnd = insideEnd;
+
+    buildRange(begin + 1, insideEnd);
+    buildRange(insideEnd, end);
+}
+
+// ----- QUERIES -----
+
+void OrientationIndex::searchNearest(size_t begin, size_t end, const double* query, size_t k,
+                                     OrientationMatch* heap, size_t& heapSize) const {
+    if (begin >= end)
+        return;
+
+    double distance = distanceTo(begin, query);
+    if (heapSize < k) {
+        heap[heapSize++] = {(size_t)ids[begin], distance};
+        std::push_heap(heap, heap + heapSize, closerMatch);
+    } else if (distance < heap[0].angle) {
+        std::pop_heap(heap, heap + heapSize, closerMatch);
+        heap[heapSize - 1] = {(size_t)ids[begin], distance};
+        std::push_heap(heap, heap + heapSize, closerMatch);
+    }
+
+    const Node& node = nodes[begin];
+    if (end - begin == 1)
+        return;
+
+    // Search the side holding the query first, the other side only if the current k-th match
+    // is far enough to reach across the threshold
+    if (distance < node.threshold) {
+        searchNearest(begin + 1, node.insideEnd, query, k, heap, heapSize);
+        if (heapSize < k || distance + heap[0].angle >= node.threshold)
+            searchNearest(node.insideEnd, end, query, k, heap, heapSize);
+    } else {
+        searchNearest(node.insideEnd, end, query, k, heap, heapSize);
+        if (heapSize < k || distance - heap[0].angle <= node.threshold)
+            searchNearest(begin + 1, node.insideEnd, query, k, heap, heapSize);
+    }
+}
+
+void OrientationIndex::searchWithin(size_t begin, size_t end, const double* query, double maxAngle,
+                                    std::vector<OrientationMatch>& out) const {
+    if (begin >= end)
+        return;
+
+    double distance = distanceTo(begin, query);
+    if (distance <= maxAngle)
+        out.push_back({(size_t)ids[begin], distance});
+
+    if (end - begin == 1)
+        return;
+
+    const Node& node = nodes[begin];
+    if (distance - maxAngle <= node.threshold)
+        searchWithin(begin + 1, node.insideEnd, query, maxAngle, out);
+    if (distance + maxAngle >= node.threshold)
+        searchWithin(node.insideEnd, end, query, maxAngle, out);
+}
+
+std::vector<OrientationMatch> OrientationIndex::nearest(const Quaternion& query, size_t k) const {
+    std::vector<OrientationMatch> heap;
+    if (k == 0)
+        return heap;
+
+    double normalized[4];
+    normalizeInto(query, normalized);
+
+    heap.resize(k < ids.size() ? k : ids.size());
+    size_t heapSize = 0;
+    searchNearest(0, ids.size(), normalized, k, heap.data(), heapSize);
+    std::sort_heap(heap.begin(), heap.end(), closerMatch);
+
+    return heap;
+}
+
+std::vector<OrientationMatch> OrientationIndex::withinAngle(const Quaternion& query, double maxAngle) const {
+    double normalized[4];
+    normalizeInto(query, normalized);
+
+    std::vector<OrientationMatch> matches;
+    searchWithin(0, ids.size(), normalized, maxAngle, matches);
+    std::sort(matches.begin(), matches.end(), closerMatch);
+
+    return matches;
+}
+
+void OrientationIndex::nearestBatch(const Quaternion* queries, size_t queryCount, size_t k, OrientationMatch* out,
+                                    FrameArena* scratch) const {
+    if (k == 0)
+        return;
+
+    // One heap per thread, taken here since the arena is not thread-safe
+    size_t workerCount = getWorkerCount(queryCount, ORIENTATION_QUERIES_PER_WORKER);
+    std::vector<OrientationMatch> storage;
+    OrientationMatch* heaps = allocateScratch(scratch, storage, workerCount * k, OrientationMatch{SIZE_MAX, 0});
+
+    parallelRanges(queryCount, workerCount, [&](size_t worker, size_t begin, size_t end) {
+        OrientationMatch* heap = heaps + worker * k;
+
+        for (size_t i = begin; i < end; ++i) {
+            double normalized[4];
+            normalizeInto(queries[i], normalized);
+
+            size_t heapSize = 0;
+            searchNearest(0, ids.size(), normalized, k, heap, heapSize);
+            std::sort_heap(heap, heap + heapSize, closerMatch);
+
+            OrientationMatch* matches = out + i * k;
+            for (size_t j = 0; j < k; ++j)
+                matches[j] = j < heapSize ? heap[j] : OrientationMatch{SIZE_MAX, 0};
+        }
+    });
+}
+
+// ----- SERIALIZATION -----
+
+uint32_t OrientationIndex::computeChecksum() const {
+    uint32_t checksum = computeCrc32(reinterpret_cast<const unsigned char*>(points.data()), points.size() * sizeof(double));
+    checksum = computeCrc32(reinterpret_cast<const unsigned char*>(ids.data()), ids.size() * sizeof(uint64_t), checksum);
+    return computeCrc32(reinterpret_cast<const unsigned char*>(nodes.data()), nodes.size() * sizeof(Node), checksum);
+}
+
+// Every range must split into children inside it, otherwise queries would read past the arrays.
+// Walked with an explicit stack since a damaged file could describe a tree as deep as it is large.
+bool OrientationIndex::isWellFormed() const {
+    size_t count = ids.size();
+    for (size_t i = 0; i < count; ++i) {
+        if (ids[i] >= count || !(nodes[i].threshold >= 0))
+            return false;
+    }
+
+    std::vector<std::pair<size_t, size_t>> ranges;
+    if (count != 0)
+        ranges.emplace_back(0, count);
+    while (!ranges.empty()) {
+        size_t begin = ranges.back().first;
+        size_t end = ranges.back().second;
+        ranges.pop_back();
+
+        uint64_t insideEnd = nodes[begin].insideEnd;
+        if (insideEnd < begin + 1 || insideEnd > end)
+            return false;
+
+        if (begin + 1 < insideEnd)
+            ranges.emplace_back(begin + 1, insideEnd);
+        if (insideEnd < end)
+            ranges.emplace_back(insideEnd, end);
+    }
+
+    return true;
+}
+
+// Layout: magic, version, count, then the points, ids and nodes arrays as stored in memory,
+// then the CRC-32 of those three arrays
+bool OrientationIndex::save(const char* path) const {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "ERROR::ORIENTATION_INDEX::CANNOT_OPEN\n%s\n", path);
+        return false;
+    }
+
+    uint64_t count = ids.size();
+    bool written = fwrite(ORIENTATION_INDEX_MAGIC, 1, 4, file) == 4
+            && fwrite(&ORIENTATION_INDEX_VERSION, sizeof(uint32_t), 1, file) == 1
+            && fwrite(&count, sizeof(uint64_t), 1, file) == 1
+            && fwrite(points.data(), sizeof(double), count * 4, file) == count * 4
+            && fwrite(ids.data(), sizeof(uint64_t), count, file) == count
+            && fwrite(nodes.data(), sizeof(Node), count, file) == count;
+    uint32_t checksum = computeChecksum();
+    written = written && fwrite(&checksum, sizeof(uint32_t), 1, file) == 1;
+
+    if (fclose(file) != 0)
+        written = false;
+    if (!written)
+        fprintf(stderr, "ERROR::ORIENTATION_INDEX::WRITE_FAILED\n%s\n", path);
+
+    return written;
+}
+
+bool OrientationIndex::load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "ERROR::ORIENTATION_INDEX::CANNOT_OPEN\n%s\n", path);
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t count = 0;
+    bool valid = fread(magic, 1, 4, file) == 4 && memcmp(magic, ORIENTATION_INDEX_MAGIC, 4) == 0
+            && fread(&version, sizeof(uint32_t), 1, file) == 1 && version == ORIENTATION_INDEX_VERSION
+            && fread(&count, sizeof(uint64_t), 1, file) == 1;
+
+    // Check the size before allocating anything, a corrupted count must not turn into a huge allocation
+    if (valid) {
+        long header = ftell(file);
+        fseek(file, 0, SEEK_END);
+        uint64_t remaining = ftell(file) - header;
+        fseek(file, header, SEEK_SET);
+        uint64_t recordSize = 4 * sizeof(double) + sizeof(uint64_t) + sizeof(Node);
+        valid = remaining >= sizeof(uint32_t) && count <= (remaining - sizeof(uint32_t)) / recordSize
+                && remaining == count * recordSize + sizeof(uint32_t);
+    }
+
+    uint32_t checksum = 0;
+    if (valid) {
+        points.resize(count * 4);
+        ids.resize(count);
+        nodes.resize(count);
+        valid = fread(points.data(), sizeof(double), count * 4, file) == count * 4
+                && fread(ids.data(), sizeof(uint64_t), count, file) == count
+                && fread(nodes.data(), sizeof(Node), count, file) == count
+                && fread(&checksum, sizeof(uint32_t), 1, file) == 1;
+    }
+    fclose(file);
+
+    // The checksum catches accidental damage, the structure check anything that would make queries unsafe
+    valid = valid && checksum == computeChecksum() && isWellFormed();
+
+    if (!valid) {
+        fprintf(stderr, "ERROR::ORIENTATION_INDEX::INVALID_FILE\n%s\n", path);
+        points.clear();
+        ids.clear();
+        nodes.clear();
+    }
+
+    return valid;
+}
@@ -0,0 +1,73 @@
+#ifndef QUATERNION_ORIENTATION_INDEX_H
+#define QUATERNION_ORIENTATION_INDEX_H
+
+#include "library.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct FrameArena;
+
+struct OrientationMatch
+{
+public:
+    size_t index;   // Position of the orientation in the array given to build()
+    double angle;   // Geodesic angle to the query in radians, in [0, pi]
+};
+
+// Vantage-point tree over orientations for nearest-neighbour and radius queries.
+// Distances are rotation angles between orientations, so q and -q are the same point.
+struct OrientationIndex
+{
+public:
+    OrientationIndex();
+
+    // Orientations do not need to be normalized, they are copied
+    void build(const Quaternion* orientations, size_t count);
+
+    // Up to k closest orientations, closest first
+    std::vector<OrientationMatch> nearest(const Quaternion& query, size_t k) const;
+    // Every orientation within maxAngle radians, closest first
+    std::vector<OrientationMatch> withinAngle(const Quaternion& query, double maxAngle) const;
+    // k closest orientations of every query, spread across threads. Results of query i are at out[i * k],
+    // when the index holds fewer than k orientations the rest is filled with index SIZE_MAX.
+    // The per-thread search heaps come from scratch when it is given.
+    void nearestBatch(const Quaternion* queries, size_t queryCount, size_t k, OrientationMatch* out,
+                      FrameArena* scratch = nullptr) const;
+
+    // Binary dump of the built tree with a checksum, returns false and prints the reason on stderr on failure.
+    // load() also rejects files whose tree structure is inconsistent.
+    bool save(const char* path) const;
+    bool load(const char* path);
+
+    size_t size() const;
+
+    // Angle of the rotation taking p to q
+    static double angleBetween(const Quaternion& p, const Quaternion& q);
+
+private:
+    // Node at position i is the vantage point of the range [i, end): points closer than threshold
+    // are in [i + 1, insideEnd), the others in [insideEnd, end)
+    struct Node
+    {
+        double threshold;
+        uint64_t insideEnd;
+    };
+
+    // Normalized orientations in tree order, 4 values each
+    std::vector<double> points;
+    // Original position of every point
+    std::vector<uint64_t> ids;
+    std::vector<Node> nodes;
+
+    void buildRange(size_t begin, size_t end);
+    uint32_t computeChecksum() const;
+    bool isWellFormed() const;
+    double distanceTo(size_t point, const double* query) const;
+    // heap holds heapSize matches as a max-heap on angle, with room for k
+    void searchNearest(size_t begin, size_t end, const double* query, size_t k, OrientationMatch* heap, size_t& heapSize) const;
+    void searchWithin(size_t begin, size_t end, const double* query, double maxAngle, std::vector<OrientationMatch>& out) const;
+};
+
+#endif //QUATERNION_ORIENTATION_INDEX_H
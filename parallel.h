@@ -0,0 +1,44 @@
+#ifndef QUATERNION_PARALLEL_H
+#define QUATERNION_PARALLEL_H
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Number of threads worth using for count items when each thread should get at least minPerWorker of them
+inline size_t getWorkerCount(size_t count, size_t minPerWorker) {
+    size_t hardware = std::thread::hardware_concurrency();
+    if (hardware == 0)
+        hardware = 1;
+
+    size_t useful = count / (minPerWorker > 0 ? minPerWorker : 1);
+    if (useful == 0)
+        useful = 1;
+
+    return useful < hardware ? useful : hardware;
+}
+
+// Splits [0, count) into workerCount contiguous ranges and runs task(worker, begin, end) on each of them.
+// The calling thread takes the first range, ranges are in order so worker i always gets the i-th slice.
+template<typename Task>
+void parallelRanges(size_t count, size_t workerCount, Task task) {
+    if (workerCount <= 1) {
+        task(0, 0, count);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(workerCount - 1);
+    for (size_t worker = 1; worker < workerCount; ++worker) {
+        size_t begin = count * worker / workerCount;
+        size_t end = count * (worker + 1) / workerCount;
+        threads.emplace_back([&task, worker, begin, end]() { task(worker, begin, end); });
+    }
+
+    task(0, 0, count / workerCount);
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+#endif //QUATERNION_PARALLEL_H
@@ -0,0 +1,379 @@
+#include "pointcloud.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Points per chunk, a chunk is the unit of work handed to a thread and released once done
+static const size_t POINT_CLOUD_CHUNK = 1 << 18;
+
+// Where the coordinates are inside the file
+struct PointCloudLayout
+{
+    size_t dataOffset;
+    size_t dataSize;
+    size_t stride;
+    size_t count;
+    size_t offsets[3];
+    bool isDouble[3];
+};
+
+// ----- ROTATION -----
+
+PointCloudRotation::PointCloudRotation(const Quaternion& rotation, Double3 origin) {
+    Double3 zero = Double3(0, 0, 0).rotate(rotation, origin);
+    Double3 columns[3] = {
+            Double3(1, 0, 0).rotate(rotation, origin).subtract(zero),
+            Double3(0, 1, 0).rotate(rotation, origin).subtract(zero),
+            Double3(0, 0, 1).rotate(rotation, origin).subtract(zero)
+    };
+
+    for (int column = 0; column < 3; ++column) {
+        matrix[column] = columns[column].x;
+        matrix[3 + column] = columns[column].y;
+        matrix[6 + column] = columns[column].z;
+    }
+
+    translation[0] = zero.x;
+    translation[1] = zero.y;
+    translation[2] = zero.z;
+}
+
+void PointCloudRotation::apply(double& x, double& y, double& z) const {
+    double rx = matrix[0] * x + matrix[1] * y + matrix[2] * z + translation[0];
+    double ry = matrix[3] * x + matrix[4] * y + matrix[5] * z + translation[1];
+    double rz = matrix[6] * x + matrix[7] * y + matrix[8] * z + translation[2];
+    x = rx;
+    y = ry;
+    z = rz;
+}
+
+// ----- LAYOUT -----
+
+static size_t getPlyTypeSize(const std::string& type) {
+    if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+        return 1;
+    if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+        return 2;
+    if (type == "int" || type == "uint" || type == "float" || type == "int32" || type == "uint32" || type == "float32")
+        return 4;
+    if (type == "double" || type == "float64")
+        return 8;
+    return 0;
+}
+
+static bool parsePlyHeader(const char* data, size_t size, PointCloudLayout& layout) {
+    const char* end = static_cast<const char*>(memmem(data, size < (1 << 16) ? size : (1 << 16), "end_header\n", 11));
+    if (end == nullptr) {
+        fprintf(stderr, "ERROR::POINTCLOUD::PLY_HEADER_NOT_FOUND\n");
+        return false;
+    }
+    layout.dataOffset = end + 11 - data;
+
+    std::string header(data, end);
+    size_t position = 0;
+    int element = 0; // 0 = none yet, 1 = vertex, 2 = after vertex
+    int found = 0;
+    bool binaryLittleEndian = false;
+
+    layout.stride = 0;
+    layout.count = 0;
+
+    while (position < header.size()) {
+        size_t lineEnd = header.find('\n', position);
+        if (lineEnd == std::string::npos)
+            lineEnd = header.size();
+
+        char keyword[32] = {}, first[32] = {}, second[32] = {};
+        sscanf(header.c_str() + position, "%31s %31s %31s", keyword, first, second);
+        position = lineEnd + 1;
+
+        if (strcmp(keyword, "format") == 0) {
+            binaryLittleEndian = strcmp(first, "binary_little_endian") == 0;
+        } else if (strcmp(keyword, "element") == 0) {
+            if (element == 0 && strcmp(first, "vertex") != 0) {
+                fprintf(stderr, "ERROR::POINTCLOUD::PLY_VERTEX_NOT_FIRST\n");
+                return false;
+            }
+            if (element == 0)
+                layout.count = strtoull(second, nullptr, 10);
+            element++;
+        } else if (strcmp(keyword, "property") == 0 && element == 1) {
+            if (strcmp(first, "list") == 0) {
+                fprintf(stderr, "ERROR::POINTCLOUD::PLY_VERTEX_LIST_PROPERTY\n");
+                return false;
+            }
+
+            size_t typeSize = getPlyTypeSize(first);
+            if (typeSize == 0) {
+                fprintf(stderr, "ERROR::POINTCLOUD::PLY_UNKNOWN_TYPE\n%s\n", first);
+                return false;
+            }
+
+            int axis = strcmp(second, "x") == 0 ? 0 : strcmp(second, "y") == 0 ? 1 : strcmp(second, "z") == 0 ? 2 : -1;
+            if (axis >= 0) {
+                if (typeSize != 4 && typeSize != 8) {
+                    fprintf(stderr, "ERROR::POINTCLOUD::PLY_COORDINATE_NOT_FLOATING_POINT\n");
+                    return false;
+                }
+                layout.offsets[axis] = layout.stride;
+                layout.isDouble[axis] = typeSize == 8;
+                found |= 1 << axis;
+            }
+            layout.stride += typeSize;
+        }
+    }
+
+    if (!binaryLittleEndian) {
+        fprintf(stderr, "ERROR::POINTCLOUD::PLY_NOT_BINARY_LITTLE_ENDIAN\n");
+        return false;
+    }
+    if (found != 7) {
+        fprintf(stderr, "ERROR::POINTCLOUD::PLY_MISSING_COORDINATES\n");
+        return false;
+    }
+    // Divided rather than multiplied, a huge count would wrap count * stride around
+    if (layout.count > (size - layout.dataOffset) / layout.stride) {
+        fprintf(stderr, "ERROR::POINTCLOUD::PLY_TRUNCATED\n");
+        return false;
+    }
+
+    layout.dataSize = layout.count * layout.stride;
+    return true;
+}
+
+static bool getLayout(const char* data, size_t size, PointCloudFormat format, PointCloudLayout& layout) {
+    if (format == POINT_CLOUD_PLY)
+        return parsePlyHeader(data, size, layout);
+
+    size_t scalarSize = format == POINT_CLOUD_XYZ_DOUBLE ? 8 : 4;
+    layout.dataOffset = 0;
+    layout.stride = 3 * scalarSize;
+    layout.count = size / layout.stride;
+    layout.dataSize = layout.count * layout.stride;
+    for (int axis = 0; axis < 3; ++axis) {
+        layout.offsets[axis] = axis * scalarSize;
+        layout.isDouble[axis] = scalarSize == 8;
+    }
+
+    if (layout.dataSize != size)
+        fprintf(stderr, "WARNING::POINTCLOUD::TRAILING_BYTES_COPIED\n");
+
+    return true;
+}
+
+// ----- STREAMING -----
+
+// Drops the pages of [begin, end) from the process once they are done with, writing them back first if dirty
+static void releaseRange(char* mapping, size_t mappingSize, size_t begin, size_t end, bool dirty) {
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t first = begin / pageSize * pageSize;
+    size_t last = (end + pageSize - 1) / pageSize * pageSize;
+    if (last > mappingSize)
+        last = mappingSize;
+    if (last <= first)
+        return;
+
+    if (dirty)
+        msync(mapping + first, last - first, MS_ASYNC);
+    madvise(mapping + first, last - first, MADV_DONTNEED);
+}
+
+static void copyBytes(const char* input, char* output, size_t size, size_t begin, size_t end) {
+    static const size_t step = POINT_CLOUD_CHUNK * 16;
+    for (size_t position = begin; position < end; position += step) {
+        size_t stop = position + step < end ? position + step : end;
+        memcpy(output + position, input + position, stop - position);
+        releaseRange(const_cast<char*>(input), size, position, stop, false);
+        releaseRange(output, size, position, stop, true);
+    }
+}
+
+static double loadCoordinate(const char* record, size_t offset, bool isDouble) {
+    if (isDouble) {
+        double value;
+        memcpy(&value, record + offset, sizeof(value));
+        return value;
+    }
+    float value;
+    memcpy(&value, record + offset, sizeof(value));
+    return value;
+}
+
+static void storeCoordinate(char* record, size_t offset, bool isDouble, double value) {
+    if (isDouble) {
+        memcpy(record + offset, &value, sizeof(value));
+        return;
+    }
+    float single = (float)value;
+    memcpy(record + offset, &single, sizeof(single));
+}
+
+static void rotateChunk(const char* input, char* output, const PointCloudLayout& layout, const PointCloudRotation& rotation,
+                        size_t begin, size_t end) {
+    const char* source = input + layout.dataOffset + begin * layout.stride;
+    char* destination = output + layout.dataOffset + begin * layout.stride;
+
+    // Carry the other properties over, then overwrite the coordinates
+    memcpy(destination, source, (end - begin) * layout.stride);
+
+    for (size_t i = begin; i < end; ++i) {
+        double x = loadCoordinate(source, layout.offsets[0], layout.isDouble[0]);
+        double y = loadCoordinate(source, layout.offsets[1], layout.isDouble[1]);
+        double z = loadCoordinate(source, layout.offsets[2], layout.isDouble[2]);
+
+        rotation.apply(x, y, z);
+
+        storeCoordinate(destination, layout.offsets[0], layout.isDouble[0], x);
+        storeCoordinate(destination, layout.offsets[1], layout.isDouble[1], y);
+        storeCoordinate(destination, layout.offsets[2], layout.isDouble[2], z);
+
+        source += layout.stride;
+        destination += layout.stride;
+    }
+}
+
+bool rotatePointCloudFile(const char* inputPath, const char* outputPath, const Quaternion& rotation, Double3 origin,
+                          PointCloudFormat format, size_t threadCount) {
+    int inputFile = open(inputPath, O_RDONLY);
+    if (inputFile < 0) {
+        fprintf(stderr, "ERROR::POINTCLOUD::CANNOT_OPEN_INPUT\n%s\n", inputPath);
+        return false;
+    }
+
+    struct stat inputStat;
+    if (fstat(inputFile, &inputStat) != 0) {
+        fprintf(stderr, "ERROR::POINTCLOUD::CANNOT_OPEN_INPUT\n%s\n", inputPath);
+        close(inputFile);
+        return false;
+    }
+    size_t size = inputStat.st_size;
+
+    // The input is checked before the output is touched, so a bad input leaves an existing output as it was
+    if (size == 0) {
+        close(inputFile);
+        if (format == POINT_CLOUD_PLY) {
+            fprintf(stderr, "ERROR::POINTCLOUD::PLY_HEADER_NOT_FOUND\n");
+            return false;
+        }
+    }
+
+    char* input = nullptr;
+    PointCloudLayout layout;
+    if (size != 0) {
+        input = static_cast<char*>(mmap(nullptr, size, PROT_READ, MAP_SHARED, inputFile, 0));
+        close(inputFile);
+        if (input == MAP_FAILED) {
+            fprintf(stderr, "ERROR::POINTCLOUD::MMAP_FAILED\n");
+            return false;
+        }
+
+        madvise(input, size, MADV_SEQUENTIAL);
+        if (!getLayout(input, size, format, layout)) {
+            munmap(input, size);
+            return false;
+        }
+    }
+
+    // Opened without O_TRUNC: when both paths name the same file (same path, hard link, symlink, ...),
+    // truncating would wipe the input before it is read. O_EXCL tells whether the file is ours to remove on failure.
+    bool created = true;
+    int outputFile = open(outputPath, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (outputFile < 0 && errno == EEXIST) {
+        created = false;
+        outputFile = open(outputPath, O_RDWR);
+    }
+
+    struct stat outputStat;
+    if (outputFile >= 0 && fstat(outputFile, &outputStat) == 0
+        && outputStat.st_dev == inputStat.st_dev && outputStat.st_ino == inputStat.st_ino) {
+        fprintf(stderr, "ERROR::POINTCLOUD::OUTPUT_IS_INPUT\n%s\n", outputPath);
+        close(outputFile);
+        if (input != nullptr)
+            munmap(input, size);
+        return false;
+    }
+
+    // Every byte of the output is written below, setting the size is enough to replace an existing file
+    if (outputFile < 0 || ftruncate(outputFile, size) != 0) {
+        fprintf(stderr, "ERROR::POINTCLOUD::CANNOT_CREATE_OUTPUT\n%s\n", outputPath);
+        if (outputFile >= 0)
+            close(outputFile);
+        if (created && outputFile >= 0)
+            unlink(outputPath);
+        if (input != nullptr)
+            munmap(input, size);
+        return false;
+    }
+
+    if (size == 0) {
+        close(outputFile);
+        return true;
+    }
+
+    char* output = static_cast<char*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, outputFile, 0));
+    close(outputFile);
+
+    if (output == MAP_FAILED) {
+        fprintf(stderr, "ERROR::POINTCLOUD::MMAP_FAILED\n");
+        if (created)
+            unlink(outputPath);
+        munmap(input, size);
+        return false;
+    }
+
+    PointCloudRotation pointRotation = PointCloudRotation(rotation, origin);
+
+    // Header, then points chunk by chunk, then whatever follows them (PLY faces, ...)
+    memcpy(output, input, layout.dataOffset);
+
+    size_t chunkCount = (layout.count + POINT_CLOUD_CHUNK - 1) / POINT_CLOUD_CHUNK;
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+    if (threadCount > chunkCount)
+        threadCount = chunkCount > 0 ? chunkCount : 1;
+
+    std::atomic<size_t> nextChunk(0);
+    auto worker = [&]() {
+        for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            size_t begin = chunk * POINT_CLOUD_CHUNK;
+            size_t end = begin + POINT_CLOUD_CHUNK < layout.count ? begin + POINT_CLOUD_CHUNK : layout.count;
+            rotateChunk(input, output, layout, pointRotation, begin, end);
+
+            size_t byteBegin = layout.dataOffset + begin * layout.stride;
+            size_t byteEnd = layout.dataOffset + end * layout.stride;
+            releaseRange(input, size, byteBegin, byteEnd, false);
+            releaseRange(output, size, byteBegin, byteEnd, true);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    copyBytes(input, output, size, layout.dataOffset + layout.dataSize, size);
+
+    bool synced = msync(output, size, MS_SYNC) == 0;
+    munmap(input, size);
+    munmap(output, size);
+
+    if (!synced) {
+        fprintf(stderr, "ERROR::POINTCLOUD::WRITE_FAILED\n%s\n", outputPath);
+        if (created)
+            unlink(outputPath);
+    }
+    return synced;
+}
@@ -0,0 +1,37 @@
+#ifndef QUATERNION_POINTCLOUD_H
+#define QUATERNION_POINTCLOUD_H
+
+#include "library.h"
+
+#include <cstddef>
+
+enum PointCloudFormat
+{
+    // Packed x, y, z records without any header
+    POINT_CLOUD_XYZ_FLOAT,
+    POINT_CLOUD_XYZ_DOUBLE,
+    // binary_little_endian PLY, vertex element first with float or double x, y, z properties
+    POINT_CLOUD_PLY
+};
+
+// Double3::rotate(quaternion, origin) is affine in the point, so it is evaluated once per basis vector
+// and then applied to every point as a 3x3 matrix plus a translation.
+struct PointCloudRotation
+{
+public:
+    double matrix[9];
+    double translation[3];
+
+    PointCloudRotation(const Quaternion& rotation, Double3 origin);
+
+    void apply(double& x, double& y, double& z) const;
+};
+
+// Rotates every point of inputPath into outputPath. Both files are memory-mapped and processed in fixed-size
+// chunks shared by threadCount threads (0 = one per core), pages are released as soon as a chunk is done so
+// memory use does not depend on the file size. Other PLY properties and elements are copied untouched.
+// Returns false and prints the reason on stderr on failure.
+bool rotatePointCloudFile(const char* inputPath, const char* outputPath, const Quaternion& rotation, Double3 origin,
+                          PointCloudFormat format, size_t threadCount = 0);
+
+#endif //QUATERNION_POINTCLOUD_H
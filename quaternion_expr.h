@@ -0,0 +1,175 @@
+#ifndef QUATERNION_EXPR_H
+#define QUATERNION_EXPR_H
+
+#include "library.h"
+
+#include <type_traits>
+
+// Lazy quaternion arithmetic: p * q, p + q and ~q (conjugate) build a small expression tree instead of a
+// Quaternion per step, the whole tree is evaluated in one inlined pass when it is converted to a Quaternion.
+//     Quaternion rotated = q * v * ~q;
+// Leaves keep references to their operands, so an expression must be converted before the end of the
+// statement that built it (never store one in an auto variable).
+
+template<typename E>
+struct QuaternionExpression
+{
+public:
+    const E& self() const { return static_cast<const E&>(*this); }
+
+    operator Quaternion() const { return self().evaluate(); }
+};
+
+struct QuaternionTerm : QuaternionExpression<QuaternionTerm>
+{
+public:
+    const Quaternion& value;
+
+    explicit QuaternionTerm(const Quaternion& value) : value(value) {}
+
+    Quaternion evaluate() const { return value; }
+};
+
+template<typename E>
+struct QuaternionConjugate : QuaternionExpression<QuaternionConjugate<E>>
+{
+public:
+    E inner;
+
+    explicit QuaternionConjugate(const E& inner) : inner(inner) {}
+
+    Quaternion evaluate() const {
+        Quaternion q = inner.evaluate();
+        return Quaternion(q.a, -q.b, -q.c, -q.d);
+    }
+};
+
+template<typename L, typename R>
+struct QuaternionSum : QuaternionExpression<QuaternionSum<L, R>>
+{
+public:
+    L left;
+    R right;
+
+    QuaternionSum(const L& left, const R& right) : left(left), right(right) {}
+
+    Quaternion evaluate() const {
+        Quaternion p = left.evaluate();
+        Quaternion q = right.evaluate();
+        return Quaternion(p.a + q.a, p.b + q.b, p.c + q.c, p.d + q.d);
+    }
+};
+
+// Same formula as Quaternion::multiply, usable on const operands
+inline Quaternion multiplyQuaternions(const Quaternion& p, const Quaternion& q) {
+    return Quaternion(
+            p.a * q.a - p.b * q.b - p.c * q.c - p.d * q.d,
+            p.a * q.b + p.b * q.a + p.c * q.d - p.d * q.c,
+            p.a * q.c - p.b * q.d + p.c * q.a + p.d * q.b,
+            p.a * q.d + p.b * q.c - p.c * q.b + p.d * q.a
+    );
+}
+
+// q * v * ~q without the two products: with q = (w, u) and v = (s, p),
+// q v q* = (s |q|^2, (w^2 - u.u) p + 2 (u.p) u + 2 w (u x p))
+inline Quaternion sandwichQuaternions(const Quaternion& q, const Quaternion& v) {
+    double uu = q.b * q.b + q.c * q.c + q.d * q.d;
+    double up = q.b * v.b + q.c * v.c + q.d * v.d;
+    double scale = q.a * q.a - uu;
+    double w2 = 2 * q.a;
+
+    return Quaternion(
+            v.a * (q.a * q.a + uu),
+            scale * v.b + 2 * up * q.b + w2 * (q.c * v.d - q.d * v.c),
+            scale * v.c + 2 * up * q.c + w2 * (q.d * v.b - q.b * v.d),
+            scale * v.d + 2 * up * q.d + w2 * (q.b * v.c - q.c * v.b)
+    );
+}
+
+template<typename L, typename R>
+struct QuaternionProduct : QuaternionExpression<QuaternionProduct<L, R>>
+{
+public:
+    L left;
+    R right;
+
+    QuaternionProduct(const L& left, const R& right) : left(left), right(right) {}
+
+    Quaternion evaluate() const {
+        return multiplyQuaternions(left.evaluate(), right.evaluate());
+    }
+};
+
+// Rewrite of the sandwich q * v * ~q, used when both outer operands hold the same quaternion
+template<typename V>
+struct QuaternionProduct<QuaternionProduct<QuaternionTerm, V>, QuaternionConjugate<QuaternionTerm>>
+        : QuaternionExpression<QuaternionProduct<QuaternionProduct<QuaternionTerm, V>, QuaternionConjugate<QuaternionTerm>>>
+{
+public:
+    QuaternionProduct<QuaternionTerm, V> left;
+    QuaternionConjugate<QuaternionTerm> right;
+
+    QuaternionProduct(const QuaternionProduct<QuaternionTerm, V>& left, const QuaternionConjugate<QuaternionTerm>& right) :
+            left(left), right(right) {}
+
+    Quaternion evaluate() const {
+        const Quaternion& q = left.left.value;
+        const Quaternion& r = right.inner.value;
+        Quaternion v = left.right.evaluate();
+
+        if (q.a == r.a && q.b == r.b && q.c == r.c && q.d == r.d)
+            return sandwichQuaternions(q, v);
+
+        return multiplyQuaternions(multiplyQuaternions(q, v), right.evaluate());
+    }
+};
+
+// ----- OPERATORS -----
+
+template<typename T>
+struct IsQuaternionOperand
+{
+    static const bool value = std::is_same<T, Quaternion>::value || std::is_base_of<QuaternionExpression<T>, T>::value;
+};
+
+template<typename T>
+struct QuaternionExpressionOf
+{
+    typedef T type;
+};
+
+template<>
+struct QuaternionExpressionOf<Quaternion>
+{
+    typedef QuaternionTerm type;
+};
+
+inline QuaternionTerm asQuaternionExpression(const Quaternion& q) {
+    return QuaternionTerm(q);
+}
+
+template<typename E>
+const E& asQuaternionExpression(const QuaternionExpression<E>& e) {
+    return e.self();
+}
+
+template<typename L, typename R,
+        typename = typename std::enable_if<IsQuaternionOperand<L>::value && IsQuaternionOperand<R>::value>::type>
+QuaternionProduct<typename QuaternionExpressionOf<L>::type, typename QuaternionExpressionOf<R>::type>
+operator*(const L& left, const R& right) {
+    return {asQuaternionExpression(left), asQuaternionExpression(right)};
+}
+
+template<typename L, typename R,
+        typename = typename std::enable_if<IsQuaternionOperand<L>::value && IsQuaternionOperand<R>::value>::type>
+QuaternionSum<typename QuaternionExpressionOf<L>::type, typename QuaternionExpressionOf<R>::type>
+operator+(const L& left, const R& right) {
+    return {asQuaternionExpression(left), asQuaternionExpression(right)};
+}
+
+template<typename E, typename = typename std::enable_if<IsQuaternionOperand<E>::value>::type>
+QuaternionConjugate<typename QuaternionExpressionOf<E>::type> operator~(const E& e) {
+    return QuaternionConjugate<typename QuaternionExpressionOf<E>::type>(asQuaternionExpression(e));
+}
+
+#endif //QUATERNION_EXPR_H
@@ -0,0 +1,576 @@
+#include "quaternion_stream.h"
+#include "vector_math.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+static const char STREAM_MAGIC[4] = {'Q', 'S', 'T', 'M'};
+static const uint32_t STREAM_VERSION = 2;
+static const size_t STREAM_HEADER_SIZE = 16;
+static const size_t STREAM_CHUNK_HEADER_SIZE = 24;
+
+// Raw chunks are copied to and from the arrays in one go
+static_assert(sizeof(Quaternion) == 4 * sizeof(double), "Quaternion must be 4 packed doubles");
+static_assert(sizeof(Double3) == 3 * sizeof(double), "Double3 must be 3 packed doubles");
+
+// ----- CHECKSUM -----
+
+// Slicing-by-8: eight table lookups per 8 input bytes instead of one lookup per byte
+uint32_t computeCrc32(const unsigned char* data, size_t size, uint32_t previous) {
+    struct Table
+    {
+        uint32_t values[8][256];
+
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+                values[0][i] = crc;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+                for (int slice = 1; slice < 8; ++slice)
+                    values[slice][i] = (values[slice - 1][i] >> 8) ^ values[0][values[slice - 1][i] & 0xFF];
+        }
+    };
+    static const Table table;
+
+    uint32_t crc = previous ^ 0xFFFFFFFFu;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint32_t low, high;
+        memcpy(&low, data + i, 4);
+        memcpy(&high, data + i + 4, 4);
+        low ^= crc;
+        crc = table.values[7][low & 0xFF] ^ table.values[6][(low >> 8) & 0xFF]
+              ^ table.values[5][(low >> 16) & 0xFF] ^ table.values[4][low >> 24]
+              ^ table.values[3][high & 0xFF] ^ table.values[2][(high >> 8) & 0xFF]
+              ^ table.values[1][(high >> 16) & 0xFF] ^ table.values[0][high >> 24];
+    }
+    for (; i < size; ++i)
+        crc = (crc >> 8) ^ table.values[0][(crc ^ data[i]) & 0xFF];
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// ----- QUANTIZATION -----
+
+// Bits per quantized component and per packed record, 0 when the encoding is not quantized
+static int getComponentBits(StreamEncoding encoding) {
+    switch (encoding) {
+        case STREAM_QUATERNION_SMALLEST3_29:
+        case STREAM_QUATERNION_DELTA_29:
+            return 9;
+        case STREAM_QUATERNION_SMALLEST3_32:
+        case STREAM_QUATERNION_DELTA_32:
+            return 10;
+        case STREAM_QUATERNION_SMALLEST3_48:
+        case STREAM_QUATERNION_DELTA_48:
+            return 15;
+        default:
+            return 0;
+    }
+}
+
+static int getRecordBits(StreamEncoding encoding) {
+    switch (encoding) {
+        case STREAM_QUATERNION_SMALLEST3_29:
+            return 29;
+        case STREAM_QUATERNION_SMALLEST3_32:
+            return 32;
+        case STREAM_QUATERNION_SMALLEST3_48:
+            return 48;
+        default:
+            return 0;
+    }
+}
+
+static bool isDeltaEncoding(StreamEncoding encoding) {
+    return encoding == STREAM_QUATERNION_DELTA_29 || encoding == STREAM_QUATERNION_DELTA_32
+           || encoding == STREAM_QUATERNION_DELTA_48;
+}
+
+static size_t alignTo8(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+// Fixed-size records are packed by groups of PACK_GROUP records. In a group, lane l holds records l, l + 4, l + 8, ...
+// as a bit stream of 64-bit words, and the words of the 4 lanes are interleaved, so the lanes are independent and go
+// through the same shifts. The last count % PACK_GROUP records are packed one after the other.
+static const size_t PACK_LANES = 4;
+static const size_t PACK_GROUP = 64 * PACK_LANES;
+
+// Packed payload size: recordBits words per lane for each full group, then the tail bit stream with 8 spare bytes
+// so every tail record can be read with one 8-byte load
+static size_t getPackedSize(size_t count, int recordBits) {
+    size_t groups = count / PACK_GROUP;
+    size_t tail = count % PACK_GROUP;
+    return groups * recordBits * PACK_LANES * sizeof(uint64_t) + alignTo8((tail * recordBits + 7) / 8 + 8);
+}
+
+static const uint64_t SIGN_BIT = 0x8000000000000000ull;
+
+// Smallest-three records of count quaternions: index of the largest component (2 bits), then the three others
+// quantized over [-1/sqrt(2), 1/sqrt(2)] with bits each. Comparisons and selections are integer operations on
+// the bit patterns (float comparisons would stay branches), so the loop is vectorized.
+// A zero quaternion is stored as the identity; NaN or infinite components give an arbitrary but valid record.
+static void quantizeSmallestThree(const Quaternion* quaternions, size_t count, int bits, uint64_t* records) {
+    double scale = 0.5 * (double)((1u << bits) - 1);
+    uint64_t componentMask = ((uint64_t)1 << bits) - 1;
+
+    for (size_t i = 0; i < count; ++i) {
+        const Quaternion& q = quaternions[i];
+        // The offset keeps a zero quaternion finite: all its components become 0 and it is encoded as (1, 0, 0, 0)
+        double invNorm = 1 / sqrt(q.a * q.a + q.b * q.b + q.c * q.c + q.d * q.d + 1e-300);
+        uint64_t a = bitsOf(q.a * invNorm), b = bitsOf(q.b * invNorm), c = bitsOf(q.c * invNorm), d = bitsOf(q.d * invNorm);
+
+        // Absolute values of doubles order like their bit patterns, so |x| < |y| is the sign of the difference
+        uint64_t absA = a & ~SIGN_BIT, absB = b & ~SIGN_BIT, absC = c & ~SIGN_BIT, absD = d & ~SIGN_BIT;
+        uint64_t bAboveA = 0 - ((absA - absB) >> 63);
+        uint64_t dAboveC = 0 - ((absC - absD) >> 63);
+        uint64_t cdAboveAb = 0 - ((selectBits(bAboveA, absA, absB) - selectBits(dAboveC, absC, absD)) >> 63);
+
+        uint64_t isA = ~cdAboveAb & ~bAboveA, isB = ~cdAboveAb & bAboveA, isC = cdAboveAb & ~dAboveC, isD = cdAboveAb & dAboveC;
+        uint64_t index = (isB & 1) | (isC & 2) | (isD & 3);
+
+        // q and -q are the same rotation, the dropped component is made positive by flipping every sign
+        uint64_t flip = ((a & isA) | (b & isB) | (c & isC) | (d & isD)) & SIGN_BIT;
+        double kept[3] = {
+                doubleOf(selectBits(isA, a, b) ^ flip),
+                doubleOf(selectBits(cdAboveAb, c, b) ^ flip),
+                doubleOf(selectBits(isD, d, c) ^ flip)
+        };
+
+        // Rounded to the nearest step with the 2^52 trick: no float to integer conversion, which is undefined
+        // out of range. |kept| <= 1/sqrt(2) so the scaled values are in [0, 2^bits - 1].
+        uint64_t record = index;
+        for (int k = 0; k < 3; ++k) {
+            double scaled = (kept[k] * M_SQRT2 + 1) * scale + 4503599627370496.0;
+            record |= (bitsOf(scaled) & componentMask) << (2 + k * bits);
+        }
+        records[i] = record;
+    }
+}
+
+// Inverse of quantizeSmallestThree, vectorized the same way
+static void dequantizeSmallestThree(const uint64_t* records, size_t count, int bits, Quaternion* out) {
+    double step = 2 / (double)((1u << bits) - 1);
+    uint64_t componentMask = ((uint64_t)1 << bits) - 1;
+
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t record = records[i];
+
+        // Integers below 2^52 become doubles by setting the exponent of 2^52 and subtracting it
+        double kept[3];
+        double sum = 0;
+        for (int k = 0; k < 3; ++k) {
+            uint64_t component = (record >> (2 + k * bits)) & componentMask;
+            double value = (doubleOf(component | 0x4330000000000000ull) - 4503599627370496.0) * step - 1;
+            kept[k] = value * M_SQRT1_2;
+            sum += kept[k] * kept[k];
+        }
+
+        // Rounding can push the sum a hair above 1, the dropped component is then 0
+        uint64_t rest = bitsOf(1 - sum);
+        uint64_t dropped = bitsOf(sqrt(doubleOf(rest & ~(0 - (rest >> 63)))));
+
+        uint64_t low = record & 1, high = (record >> 1) & 1;
+        uint64_t isA = 0 - ((low | high) ^ 1);
+        uint64_t isB = 0 - (low & (high ^ 1));
+        uint64_t isC = 0 - ((low ^ 1) & high);
+        uint64_t isD = 0 - (low & high);
+        uint64_t k0 = bitsOf(kept[0]), k1 = bitsOf(kept[1]), k2 = bitsOf(kept[2]);
+
+        out[i].a = doubleOf(selectBits(isA, k0, dropped));
+        out[i].b = doubleOf(selectBits(isA, selectBits(isB, k1, dropped), k0));
+        out[i].c = doubleOf(selectBits(isA | isB, selectBits(isC, k2, dropped), k1));
+        out[i].d = doubleOf(selectBits(isD, k2, dropped));
+    }
+}
+
+// PACK_GROUP records into RecordBits * PACK_LANES words. 64 records of RecordBits bits fill exactly RecordBits words,
+// so every lane ends on a word boundary. The record loop is unrolled, which makes every shift and word index a
+// constant, and the lane loop is then vectorized: each lane is a 64-bit element of a SIMD register.
+template<int RecordBits>
+static void packGroup(const uint64_t* __restrict records, uint64_t* __restrict words) {
+    for (size_t l = 0; l < PACK_LANES; ++l) {
+        uint64_t accumulator = 0;
+        int filled = 0;
+        int word = 0;
+
+#pragma GCC unroll 64
+        for (int r = 0; r < 64; ++r) {
+            uint64_t record = records[r * PACK_LANES + l];
+            accumulator |= record << filled;
+            filled += RecordBits;
+            if (filled >= 64) {
+                words[word * PACK_LANES + l] = accumulator;
+                ++word;
+                filled -= 64;
+                // High bits of the record that did not fit (none when it ended exactly on the boundary)
+                accumulator = filled != 0 ? record >> (RecordBits - filled) : 0;
+            }
+        }
+    }
+}
+
+template<int RecordBits>
+static void unpackGroup(const uint64_t* __restrict words, uint64_t* __restrict records) {
+    const uint64_t recordMask = ((uint64_t)1 << RecordBits) - 1;
+
+    for (size_t l = 0; l < PACK_LANES; ++l) {
+        int consumed = 0;
+        int word = 0;
+
+#pragma GCC unroll 64
+        for (int r = 0; r < 64; ++r) {
+            uint64_t record = words[word * PACK_LANES + l] >> consumed;
+            consumed += RecordBits;
+            if (consumed > 64) {
+                // Low bits of the next word complete the record
+                ++word;
+                consumed -= 64;
+                record |= words[word * PACK_LANES + l] << (RecordBits - consumed);
+            } else if (consumed == 64) {
+                ++word;
+                consumed = 0;
+            }
+            records[r * PACK_LANES + l] = record & recordMask;
+        }
+    }
+}
+
+static void packGroup(const uint64_t* records, int recordBits, uint64_t* words) {
+    if (recordBits == 29)
+        packGroup<29>(records, words);
+    else if (recordBits == 32)
+        packGroup<32>(records, words);
+    else
+        packGroup<48>(records, words);
+}
+
+static void unpackGroup(const uint64_t* words, int recordBits, uint64_t* records) {
+    if (recordBits == 29)
+        unpackGroup<29>(words, records);
+    else if (recordBits == 32)
+        unpackGroup<32>(words, records);
+    else
+        unpackGroup<48>(words, records);
+}
+
+// ----- VARINTS -----
+
+static inline uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static void appendVarint(std::vector<unsigned char>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+static bool readVarint(const unsigned char*& position, const unsigned char* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && position < end; shift += 7) {
+        unsigned char byte = *position++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// ----- WRITER -----
+
+StreamWriter::StreamWriter() : data(STREAM_HEADER_SIZE, 0) {
+    uint32_t version = STREAM_VERSION;
+
+    // The reserved bytes stay zero
+    memcpy(&data[0], STREAM_MAGIC, 4);
+    memcpy(&data[4], &version, sizeof(version));
+}
+
+void StreamWriter::writeQuaternions(const Quaternion* quaternions, size_t count, StreamEncoding encoding) {
+    // Upper bound of the output (delta records take at most 9 bytes), avoids growing the buffer chunk after chunk
+    size_t recordSize = encoding == STREAM_QUATERNION_RAW ? 4 * sizeof(double) : isDeltaEncoding(encoding) ? 9 : 6;
+    data.reserve(data.size() + count * recordSize + (count / CHUNK_RECORDS + 1) * (STREAM_CHUNK_HEADER_SIZE + 16));
+
+    for (size_t begin = 0; begin < count; begin += CHUNK_RECORDS) {
+        size_t chunkCount = count - begin < CHUNK_RECORDS ? count - begin : CHUNK_RECORDS;
+        writeChunk(encoding, quaternions + begin, nullptr, chunkCount);
+    }
+}
+
+void StreamWriter::writeDouble3s(const Double3* vectors, size_t count) {
+    data.reserve(data.size() + count * 3 * sizeof(double) + (count / CHUNK_RECORDS + 1) * STREAM_CHUNK_HEADER_SIZE);
+
+    for (size_t begin = 0; begin < count; begin += CHUNK_RECORDS) {
+        size_t chunkCount = count - begin < CHUNK_RECORDS ? count - begin : CHUNK_RECORDS;
+        writeChunk(STREAM_DOUBLE3_RAW, nullptr, vectors + begin, chunkCount);
+    }
+}
+
+void StreamWriter::writeChunk(StreamEncoding encoding, const Quaternion* quaternions, const Double3* vectors, size_t count) {
+    // Header first, its size and checksum are filled in once the payload is known
+    size_t headerPosition = data.size();
+    data.resize(headerPosition + STREAM_CHUNK_HEADER_SIZE);
+    size_t payloadPosition = data.size();
+
+    int bits = getComponentBits(encoding);
+
+    if (encoding == STREAM_QUATERNION_RAW) {
+        data.resize(payloadPosition + count * sizeof(Quaternion));
+        memcpy(&data[payloadPosition], quaternions, count * sizeof(Quaternion));
+    } else if (encoding == STREAM_DOUBLE3_RAW) {
+        data.resize(payloadPosition + count * sizeof(Double3));
+        memcpy(&data[payloadPosition], vectors, count * sizeof(Double3));
+    } else if (isDeltaEncoding(encoding)) {
+        uint64_t records[PACK_GROUP];
+        uint64_t componentMask = ((uint64_t)1 << bits) - 1;
+        uint32_t previous[3] = {0, 0, 0};
+
+        // Quantized block by block, the varints themselves are inherently sequential
+        for (size_t begin = 0; begin < count; begin += PACK_GROUP) {
+            size_t blockCount = count - begin < PACK_GROUP ? count - begin : PACK_GROUP;
+            quantizeSmallestThree(quaternions + begin, blockCount, bits, records);
+
+            for (size_t i = 0; i < blockCount; ++i) {
+                uint32_t index = (uint32_t)(records[i] & 3);
+                uint32_t components[3];
+                for (int k = 0; k < 3; ++k)
+                    components[k] = (uint32_t)((records[i] >> (2 + k * bits)) & componentMask);
+
+                appendVarint(data, zigzag((int32_t)(components[0] - previous[0])) << 2 | index);
+                appendVarint(data, zigzag((int32_t)(components[1] - previous[1])));
+                appendVarint(data, zigzag((int32_t)(components[2] - previous[2])));
+
+                memcpy(previous, components, sizeof(previous));
+            }
+        }
+        data.resize(payloadPosition + alignTo8(data.size() - payloadPosition));
+    } else {
+        int recordBits = getRecordBits(encoding);
+        data.resize(payloadPosition + getPackedSize(count, recordBits), 0);
+        unsigned char* out = &data[payloadPosition];
+
+        uint64_t records[PACK_GROUP];
+        uint64_t words[64 * PACK_LANES];
+        size_t groupSize = recordBits * PACK_LANES * sizeof(uint64_t);
+        size_t groupCount = count / PACK_GROUP;
+
+        for (size_t group = 0; group < groupCount; ++group) {
+            quantizeSmallestThree(quaternions + group * PACK_GROUP, PACK_GROUP, bits, records);
+            packGroup(records, recordBits, words);
+            memcpy(out, words, groupSize);
+            out += groupSize;
+        }
+
+        // Tail, one record after the other
+        size_t tail = count - groupCount * PACK_GROUP;
+        quantizeSmallestThree(quaternions + groupCount * PACK_GROUP, tail, bits, records);
+        for (size_t i = 0; i < tail; ++i) {
+            size_t bitOffset = i * recordBits;
+            uint64_t word;
+            memcpy(&word, out + bitOffset / 8, sizeof(word));
+            word |= records[i] << (bitOffset % 8);
+            memcpy(out + bitOffset / 8, &word, sizeof(word));
+        }
+    }
+
+    uint32_t encodingValue = encoding;
+    uint32_t count32 = (uint32_t)count;
+    uint64_t payloadSize = data.size() - payloadPosition;
+    uint32_t checksum = computeCrc32(&data[payloadPosition], payloadSize);
+    uint32_t reserved = 0;
+
+    unsigned char* header = &data[headerPosition];
+    memcpy(header, &encodingValue, 4);
+    memcpy(header + 4, &count32, 4);
+    memcpy(header + 8, &payloadSize, 8);
+    memcpy(header + 16, &checksum, 4);
+    memcpy(header + 20, &reserved, 4);
+}
+
+// ----- CHUNK VIEW -----
+
+bool StreamChunkView::isQuaternion() const {
+    return encoding != STREAM_DOUBLE3_RAW;
+}
+
+const double* StreamChunkView::getRawValues() const {
+    if (encoding != STREAM_QUATERNION_RAW && encoding != STREAM_DOUBLE3_RAW)
+        return nullptr;
+    if (reinterpret_cast<uintptr_t>(payload) % alignof(double) != 0)
+        return nullptr;
+
+    return reinterpret_cast<const double*>(payload);
+}
+
+bool StreamChunkView::decodeQuaternions(Quaternion* out) const {
+    if (!isQuaternion())
+        return false;
+
+    if (encoding == STREAM_QUATERNION_RAW) {
+        memcpy(out, payload, count * sizeof(Quaternion));
+        return true;
+    }
+
+    int bits = getComponentBits(encoding);
+    uint64_t records[PACK_GROUP];
+
+    if (isDeltaEncoding(encoding)) {
+        const unsigned char* position = payload;
+        const unsigned char* end = payload + payloadSize;
+        uint32_t components[3] = {0, 0, 0};
+
+        // Varints decoded into records block by block, then dequantized together
+        for (size_t begin = 0; begin < count; begin += PACK_GROUP) {
+            size_t blockCount = count - begin < PACK_GROUP ? count - begin : PACK_GROUP;
+
+            for (size_t i = 0; i < blockCount; ++i) {
+                uint32_t first, second, third;
+                if (!readVarint(position, end, first) || !readVarint(position, end, second) || !readVarint(position, end, third))
+                    return false;
+
+                components[0] += unzigzag(first >> 2);
+                components[1] += unzigzag(second);
+                components[2] += unzigzag(third);
+
+                uint64_t componentMask = ((uint64_t)1 << bits) - 1;
+                records[i] = (first & 3) | (uint64_t)(components[0] & componentMask) << 2
+                             | (uint64_t)(components[1] & componentMask) << (2 + bits)
+                             | (uint64_t)(components[2] & componentMask) << (2 + 2 * bits);
+            }
+
+            dequantizeSmallestThree(records, blockCount, bits, out + begin);
+        }
+        return true;
+    }
+
+    int recordBits = getRecordBits(encoding);
+    const unsigned char* in = payload;
+    uint64_t words[64 * PACK_LANES];
+    size_t groupSize = recordBits * PACK_LANES * sizeof(uint64_t);
+    size_t groupCount = count / PACK_GROUP;
+
+    for (size_t group = 0; group < groupCount; ++group) {
+        // Copied out since a payload in a caller's buffer is not necessarily aligned
+        memcpy(words, in, groupSize);
+        in += groupSize;
+
+        unpackGroup(words, recordBits, records);
+        dequantizeSmallestThree(records, PACK_GROUP, bits, out + group * PACK_GROUP);
+    }
+
+    size_t tail = count - groupCount * PACK_GROUP;
+    uint64_t recordMask = ((uint64_t)1 << recordBits) - 1;
+    for (size_t i = 0; i < tail; ++i) {
+        size_t bitOffset = i * recordBits;
+        uint64_t word;
+        memcpy(&word, in + bitOffset / 8, sizeof(word));
+        records[i] = (word >> (bitOffset % 8)) & recordMask;
+    }
+    dequantizeSmallestThree(records, tail, bits, out + groupCount * PACK_GROUP);
+
+    return true;
+}
+
+bool StreamChunkView::decodeDouble3s(Double3* out) const {
+    if (encoding != STREAM_DOUBLE3_RAW)
+        return false;
+
+    memcpy(out, payload, count * sizeof(Double3));
+    return true;
+}
+
+// ----- READER -----
+
+StreamReader::StreamReader(const unsigned char* data, size_t size, bool verifyChecksums) :
+        data(data), size(size), position(STREAM_HEADER_SIZE), verifyChecksums(verifyChecksums), valid(false), error(nullptr) {
+    uint32_t version = 0;
+    if (size >= STREAM_HEADER_SIZE)
+        memcpy(&version, data + 4, sizeof(version));
+
+    if (size < STREAM_HEADER_SIZE || memcmp(data, STREAM_MAGIC, 4) != 0)
+        error = "not a quaternion stream";
+    else if (version != STREAM_VERSION)
+        error = "unsupported stream version";
+    else
+        valid = true;
+}
+
+bool StreamReader::isValid() const {
+    return valid;
+}
+
+const char* StreamReader::getError() const {
+    return error;
+}
+
+bool StreamReader::next(StreamChunkView& chunk) {
+    if (error != nullptr || position == size)
+        return false;
+
+    if (size - position < STREAM_CHUNK_HEADER_SIZE) {
+        error = "truncated chunk header";
+        return false;
+    }
+
+    const unsigned char* header = data + position;
+    uint32_t encoding, count, checksum;
+    uint64_t payloadSize;
+    memcpy(&encoding, header, 4);
+    memcpy(&count, header + 4, 4);
+    memcpy(&payloadSize, header + 8, 8);
+    memcpy(&checksum, header + 16, 4);
+
+    if (payloadSize > size - position - STREAM_CHUNK_HEADER_SIZE || payloadSize % 8 != 0) {
+        error = "truncated chunk payload";
+        return false;
+    }
+
+    // Fixed-size encodings must have exactly the payload their count implies
+    size_t expectedSize;
+    StreamEncoding streamEncoding = (StreamEncoding)encoding;
+    if (streamEncoding == STREAM_QUATERNION_RAW)
+        expectedSize = (size_t)count * 4 * sizeof(double);
+    else if (streamEncoding == STREAM_DOUBLE3_RAW)
+        expectedSize = (size_t)count * 3 * sizeof(double);
+    else if (getRecordBits(streamEncoding) != 0)
+        expectedSize = getPackedSize(count, getRecordBits(streamEncoding));
+    else if (isDeltaEncoding(streamEncoding))
+        // Every record takes at least 3 varint bytes, a larger count can only come from a damaged header
+        // and would make the caller allocate far more than the payload can describe
+        expectedSize = (uint64_t)count * 3 <= payloadSize ? payloadSize : 0;
+    else {
+        error = "unknown chunk encoding";
+        return false;
+    }
+
+    if (expectedSize != payloadSize) {
+        error = "chunk size does not match its record count";
+        return false;
+    }
+
+    const unsigned char* payload = header + STREAM_CHUNK_HEADER_SIZE;
+    if (verifyChecksums && computeCrc32(payload, payloadSize) != checksum) {
+        error = "chunk checksum mismatch";
+        return false;
+    }
+
+    chunk.encoding = streamEncoding;
+    chunk.count = count;
+    chunk.payload = payload;
+    chunk.payloadSize = payloadSize;
+
+    position += STREAM_CHUNK_HEADER_SIZE + payloadSize;
+    return true;
+}
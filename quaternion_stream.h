@@ -0,0 +1,98 @@
+#ifndef QUATERNION_STREAM_H
+#define QUATERNION_STREAM_H
+
+#include "library.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Versioned binary format for Quaternion and Double3 streams.
+//
+// A stream is a 16-byte header ("QSTM", version, reserved) followed by chunks. Every chunk is a 24-byte header
+// (encoding, record count, payload size, CRC-32 of the payload) and its payload, padded to 8 bytes so raw
+// payloads stay aligned for zero-copy reads. Values are little-endian, like every platform this project targets.
+enum StreamEncoding
+{
+    // 4 doubles per quaternion / 3 doubles per vector, readable in place
+    STREAM_QUATERNION_RAW = 1,
+    STREAM_DOUBLE3_RAW = 2,
+
+    // Unit quaternions, smallest-three quantization: index of the largest component (2 bits) and the three
+    // others quantized over [-1/sqrt(2), 1/sqrt(2)], with 9, 10 or 15 bits each
+    STREAM_QUATERNION_SMALLEST3_29 = 3,
+    STREAM_QUATERNION_SMALLEST3_32 = 4,
+    STREAM_QUATERNION_SMALLEST3_48 = 5,
+
+    // Same quantization, each record stored as varint differences from the previous one. Much smaller for
+    // smooth time series, but chunks can only be decoded from the start.
+    STREAM_QUATERNION_DELTA_29 = 6,
+    STREAM_QUATERNION_DELTA_32 = 7,
+    STREAM_QUATERNION_DELTA_48 = 8
+};
+
+// Appends chunks to an in-memory stream, ready to be written to a file, pipe or socket
+struct StreamWriter
+{
+public:
+    // Largest number of records in one chunk, bigger writes are split
+    static const size_t CHUNK_RECORDS = 1 << 16;
+
+    std::vector<unsigned char> data;
+
+    StreamWriter();
+
+    void writeQuaternions(const Quaternion* quaternions, size_t count, StreamEncoding encoding = STREAM_QUATERNION_RAW);
+    void writeDouble3s(const Double3* vectors, size_t count);
+
+private:
+    void writeChunk(StreamEncoding encoding, const Quaternion* quaternions, const Double3* vectors, size_t count);
+};
+
+// One chunk of a stream, pointing into the reader's buffer
+struct StreamChunkView
+{
+public:
+    StreamEncoding encoding;
+    size_t count;
+    const unsigned char* payload;
+    size_t payloadSize;
+
+    bool isQuaternion() const;
+
+    // Values of a raw chunk read in place (4 or 3 doubles per record), nullptr for other encodings
+    const double* getRawValues() const;
+
+    // out must hold count records, false when the chunk does not hold that type or is malformed
+    bool decodeQuaternions(Quaternion* out) const;
+    bool decodeDouble3s(Double3* out) const;
+};
+
+// Walks the chunks of a stream without copying it, e.g. over a memory-mapped file
+struct StreamReader
+{
+public:
+    StreamReader(const unsigned char* data, size_t size, bool verifyChecksums = true);
+
+    // False when the stream header is missing or of an unknown version
+    bool isValid() const;
+
+    // Next chunk, false at the end of the stream or on a damaged chunk (see getError)
+    bool next(StreamChunkView& chunk);
+
+    // nullptr unless reading stopped on an error
+    const char* getError() const;
+
+private:
+    const unsigned char* data;
+    size_t size;
+    size_t position;
+    bool verifyChecksums;
+    bool valid;
+    const char* error;
+};
+
+// CRC-32 (IEEE), previous continues the CRC of preceding data so a checksum can span several buffers
+uint32_t computeCrc32(const unsigned char* data, size_t size, uint32_t previous = 0);
+
+#endif //QUATERNION_STREAM_H
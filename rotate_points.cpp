@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <cstdlib>
+#include <cstring>
+#include "library.h"
+#include "pointcloud.h"
+
+// NOTE: Offline tool, rotates a point cloud file without loading it in memory
+// rotate_points <input> <output> <a> <b> <c> <d> [--origin x y z] [--double] [--threads n]
+
+void printUsage() {
+    fprintf(stderr, "Usage: rotate_points <input> <output> <a> <b> <c> <d> [--origin x y z] [--double] [--threads n]\n");
+    fprintf(stderr, "  a b c d      rotation quaternion (normalized by the tool)\n");
+    fprintf(stderr, "  --origin     point to rotate around, default 0 0 0\n");
+    fprintf(stderr, "  --double     raw input holds double instead of float xyz records (ignored for PLY)\n");
+    fprintf(stderr, "  --threads    worker threads, default one per core\n");
+}
+
+bool isPly(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    char magic[4] = {};
+    size_t read = fread(magic, 1, 4, file);
+    fclose(file);
+
+    return read == 4 && memcmp(magic, "ply\n", 4) == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 7) {
+        printUsage();
+        return 1;
+    }
+
+    Quaternion rotation = Quaternion(atof(argv[3]), atof(argv[4]), atof(argv[5]), atof(argv[6]));
+    Double3 origin = Double3(0, 0, 0);
+    bool useDouble = false;
+    size_t threadCount = 0;
+
+    for (int i = 7; i < argc; ++i) {
+        if (strcmp(argv[i], "--origin") == 0 && i + 3 < argc) {
+            origin = Double3(atof(argv[i + 1]), atof(argv[i + 2]), atof(argv[i + 3]));
+            i += 3;
+        } else if (strcmp(argv[i], "--double") == 0) {
+            useDouble = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = strtoul(argv[i + 1], nullptr, 10);
+            i += 1;
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (rotation.getNorm() == 0) {
+        fprintf(stderr, "ERROR::ROTATE_POINTS::NULL_QUATERNION\n");
+        return 1;
+    }
+
+    PointCloudFormat format = isPly(argv[1]) ? POINT_CLOUD_PLY : useDouble ? POINT_CLOUD_XYZ_DOUBLE : POINT_CLOUD_XYZ_FLOAT;
+    return rotatePointCloudFile(argv[1], argv[2], rotation, origin, format, threadCount) ? 0 : 1;
+}
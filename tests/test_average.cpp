@@ -0,0 +1,138 @@
+// exp, log and pow (scalar and batch) and the orientation averages against known results
+#include "../library.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static double quaternionError(const Quaternion& left, const Quaternion& right) {
+    return fmax(fmax(fabs(left.a - right.a), fabs(left.b - right.b)), fmax(fabs(left.c - right.c), fabs(left.d - right.d)));
+}
+
+// Error relative to the size of the expected value, exp and pow results can be large
+static double relativeError(const Quaternion& result, Quaternion expected) {
+    return quaternionError(result, expected) / fmax(1, expected.getNorm());
+}
+
+// Rotation angle in radians between two orientations, q and -q being the same one
+static double angleBetween(const Quaternion& left, const Quaternion& right) {
+    double dot = fabs(left.a * right.a + left.b * right.b + left.c * right.c + left.d * right.d);
+    return 2 * acos(dot < 1 ? dot : 1);
+}
+
+int main() {
+    const double TOLERANCE = 1e-12;
+
+    // More samples than one averaging thread takes, and not a multiple of the batch vector width
+    const size_t COUNT = 100003;
+
+    std::mt19937_64 random(5);
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<double> scale(0.1, 10);
+    bool failed = false;
+
+    // Random quaternions of random norms, then the special cases: real quaternions of both signs (zero vector
+    // part) and a vector part far below 1e-12
+    std::vector<Quaternion> quaternions;
+    quaternions.reserve(COUNT);
+    quaternions.push_back(Quaternion(1, 0, 0, 0));
+    quaternions.push_back(Quaternion(2.5, 0, 0, 0));
+    quaternions.push_back(Quaternion(-1, 0, 0, 0));
+    quaternions.push_back(Quaternion(-0.25, 0, 0, 0));
+    quaternions.push_back(Quaternion(-1, 1e-20, 0, 0));
+    quaternions.push_back(Quaternion(0.5, 0, 1e-200, 0));
+    while (quaternions.size() < COUNT) {
+        Quaternion q = Quaternion(normal(random), normal(random), normal(random), normal(random)).getUnit();
+        quaternions.push_back(q.multiply(scale(random)));
+    }
+
+    // exp(log q) = q
+    double worstRoundTrip = 0;
+    for (Quaternion q : quaternions)
+        worstRoundTrip = fmax(worstRoundTrip, relativeError(q.log().exp(), q));
+    printf("exp(log q): max relative error %g\n", worstRoundTrip);
+    failed |= !(worstRoundTrip < TOLERANCE);
+
+    // A negative real quaternion is a half turn, its logarithm takes the x axis; a positive one has no vector part
+    Quaternion negativeLog = Quaternion(-2, 0, 0, 0).log();
+    Quaternion positiveLog = Quaternion(2, 0, 0, 0).log();
+    Quaternion realExp = Quaternion(1, 0, 0, 0).exp();
+    double specialError = fmax(quaternionError(negativeLog, Quaternion(log(2.0), M_PI, 0, 0)),
+                               fmax(quaternionError(positiveLog, Quaternion(log(2.0), 0, 0, 0)),
+                                    quaternionError(realExp, Quaternion(M_E, 0, 0, 0))));
+    printf("real quaternions: max error %g\n", specialError);
+    failed |= !(specialError < TOLERANCE);
+
+    // Batch functions against the scalar ones
+    const double POWER = 0.37;
+    std::vector<Quaternion> logarithms(COUNT, Quaternion(1, 0, 0, 0));
+    std::vector<Quaternion> exponentials(COUNT, Quaternion(1, 0, 0, 0));
+    std::vector<Quaternion> powers(COUNT, Quaternion(1, 0, 0, 0));
+    Quaternion::logAll(quaternions.data(), logarithms.data(), COUNT);
+    Quaternion::expAll(quaternions.data(), exponentials.data(), COUNT);
+    Quaternion::powAll(quaternions.data(), POWER, powers.data(), COUNT);
+
+    double worstLog = 0, worstExp = 0, worstPow = 0;
+    for (size_t i = 0; i < COUNT; ++i) {
+        Quaternion q = quaternions[i];
+        worstLog = fmax(worstLog, relativeError(logarithms[i], q.log()));
+        worstExp = fmax(worstExp, relativeError(exponentials[i], q.exp()));
+        worstPow = fmax(worstPow, relativeError(powers[i], q.pow(POWER)));
+    }
+    printf("logAll: max relative error %g\n", worstLog);
+    printf("expAll: max relative error %g\n", worstExp);
+    printf("powAll: max relative error %g\n", worstPow);
+    failed |= !(worstLog < TOLERANCE) || !(worstExp < TOLERANCE) || !(worstPow < TOLERANCE);
+
+    // Noisy samples around a known orientation, each with a random sign since q and -q are the same orientation
+    Quaternion truth = Quaternion(0.3, -0.5, 0.7, 0.2).getUnit();
+    std::normal_distribution<double> noise(0, 0.05);
+    std::vector<Quaternion> samples;
+    samples.reserve(COUNT);
+    for (size_t i = 0; i < COUNT; ++i) {
+        Quaternion offset = Quaternion(0, noise(random), noise(random), noise(random)).exp();
+        Quaternion sample = truth.multiply(offset);
+        samples.push_back(random() % 2 == 0 ? sample : sample.multiply(-1));
+    }
+
+    double averageError = angleBetween(Quaternion::average(samples.data(), nullptr, COUNT), truth);
+    double geodesicError = angleBetween(Quaternion::geodesicAverage(samples.data(), nullptr, COUNT), truth);
+    printf("average of noisy samples: %g rad from the truth\n", averageError);
+    printf("geodesic average of noisy samples: %g rad from the truth\n", geodesicError);
+    failed |= !(averageError < 1e-3) || !(geodesicError < 1e-3);
+
+    // Every third sample replaced by an outlier with zero weight, which must not move the means
+    std::vector<double> weights(COUNT);
+    Quaternion outlier = Quaternion(-0.6, 0.1, 0.3, 0.7).getUnit();
+    for (size_t i = 0; i < COUNT; ++i) {
+        weights[i] = i % 3 == 0 ? 0 : 0.5 + (double)(i % 7);
+        if (i % 3 == 0)
+            samples[i] = outlier;
+    }
+
+    double weightedError = angleBetween(Quaternion::average(samples.data(), weights.data(), COUNT), truth);
+    double weightedGeodesicError = angleBetween(Quaternion::geodesicAverage(samples.data(), weights.data(), COUNT), truth);
+    printf("weighted average with outliers: %g rad from the truth\n", weightedError);
+    printf("weighted geodesic average with outliers: %g rad from the truth\n", weightedGeodesicError);
+    failed |= !(weightedError < 1e-3) || !(weightedGeodesicError < 1e-3);
+
+    // The weighted geodesic mean of two orientations is on the arc between them, at the weight of the second
+    const double SECOND_WEIGHT = 0.3;
+    Quaternion pair[2] = {truth, outlier.multiply(-1)};
+    double pairWeights[2] = {1 - SECOND_WEIGHT, SECOND_WEIGHT};
+    Quaternion arc = truth.conjugate().multiply(pair[1]);
+    if (arc.a < 0)
+        arc = arc.multiply(-1);
+    Quaternion expected = truth.multiply(arc.pow(SECOND_WEIGHT));
+    double pairError = angleBetween(Quaternion::geodesicAverage(pair, pairWeights, 2), expected);
+    printf("geodesic average of two weighted orientations: %g rad from the arc\n", pairError);
+    failed |= !(pairError < 1e-9);
+
+    if (failed) {
+        fprintf(stderr, "ERROR::TEST::AVERAGE::TOLERANCE_EXCEEDED\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+// composeAll and composeScan against a sequential product with the same renormalization
+#include "../library.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static double quaternionError(const Quaternion& left, const Quaternion& right) {
+    return fmax(fmax(fabs(left.a - right.a), fabs(left.b - right.b)), fmax(fabs(left.c - right.c), fabs(left.d - right.d)));
+}
+
+// Running product quaternions[0] * ... * quaternions[i], renormalized every renormalizeInterval steps
+static std::vector<Quaternion> sequentialScan(const std::vector<Quaternion>& quaternions, size_t count, size_t renormalizeInterval) {
+    std::vector<Quaternion> out;
+    Quaternion running = Quaternion(1, 0, 0, 0);
+    for (size_t i = 0; i < count; ++i) {
+        running = running.multiply(quaternions[i]);
+        if (renormalizeInterval != 0 && (i + 1) % renormalizeInterval == 0)
+            running = running.getUnit();
+        out.push_back(running);
+    }
+    return out;
+}
+
+int main() {
+    // Chains of unit quaternions drift by a few ulp per product, far below this
+    const double TOLERANCE = 1e-9;
+
+    // Neither multiples of 4 (the lanes of composeAll) nor of a worker slice; the two largest give several
+    // threads more than COMPOSE_CHUNK (65536) products each on a machine with more than one core
+    const size_t COUNTS[] = {1, 2, 3, 5, 63, 65, 1001, 65537, 196613, 400009};
+    const size_t INTERVALS[] = {64, 7, 1, 0};
+    const size_t MAX_COUNT = 400009;
+
+    std::mt19937_64 random(21);
+    std::normal_distribution<double> normal;
+    bool failed = false;
+
+    std::vector<Quaternion> quaternions(MAX_COUNT, Quaternion(1, 0, 0, 0));
+    for (Quaternion& q : quaternions)
+        q = Quaternion(normal(random), normal(random), normal(random), normal(random)).getUnit();
+
+    double worstAll = 0, worstScan = 0;
+    std::vector<Quaternion> out(MAX_COUNT, Quaternion(1, 0, 0, 0));
+    for (size_t interval : INTERVALS) {
+        for (size_t count : COUNTS) {
+            std::vector<Quaternion> expected = sequentialScan(quaternions, count, interval);
+            Quaternion expectedAll = interval != 0 ? expected.back().getUnit() : expected.back();
+
+            worstAll = fmax(worstAll, quaternionError(Quaternion::composeAll(quaternions.data(), count, interval), expectedAll));
+
+            Quaternion::composeScan(quaternions.data(), out.data(), count, interval);
+            for (size_t i = 0; i < count; ++i)
+                worstScan = fmax(worstScan, quaternionError(out[i], expected[i]));
+        }
+    }
+    printf("composeAll: max error %g\n", worstAll);
+    printf("composeScan: max error %g\n", worstScan);
+    failed |= !(worstAll < TOLERANCE) || !(worstScan < TOLERANCE);
+
+    // An empty chain is the identity and the scan writes nothing
+    Quaternion empty = Quaternion::composeAll(quaternions.data(), 0);
+    Quaternion emptyUnrenormalized = Quaternion::composeAll(nullptr, 0, 0);
+    Quaternion sentinel = Quaternion(2, 3, 5, 7);
+    out[0] = sentinel;
+    Quaternion::composeScan(quaternions.data(), out.data(), 0);
+    bool emptyCorrect = quaternionError(empty, Quaternion(1, 0, 0, 0)) == 0
+                        && quaternionError(emptyUnrenormalized, Quaternion(1, 0, 0, 0)) == 0
+                        && quaternionError(out[0], sentinel) == 0;
+    printf("empty chain: %s\n", emptyCorrect ? "identity" : "WRONG");
+    failed |= !emptyCorrect;
+
+    if (failed) {
+        fprintf(stderr, "ERROR::TEST::COMPOSE::TOLERANCE_EXCEEDED\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Accuracy of the batch conversions against the scalar ones they replace
+#include "../library.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static double matrixError(const RotationMatrix& left, const RotationMatrix& right) {
+    double values[9] = {
+            left.a1 - right.a1, left.a2 - right.a2, left.a3 - right.a3,
+            left.b1 - right.b1, left.b2 - right.b2, left.b3 - right.b3,
+            left.c1 - right.c1, left.c2 - right.c2, left.c3 - right.c3
+    };
+
+    double error = 0;
+    for (double value : values)
+        error = fmax(error, fabs(value));
+    return error;
+}
+
+static double quaternionError(const Quaternion& left, const Quaternion& right) {
+    return fmax(fmax(fabs(left.a - right.a), fabs(left.b - right.b)), fmax(fabs(left.c - right.c), fabs(left.d - right.d)));
+}
+
+int main() {
+    const double TOLERANCE = 1e-12;
+
+    // Not a multiple of the conversion block, to cover the last partial block
+    const size_t COUNT = 100003;
+
+    std::mt19937_64 random(42);
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<double> scale(0.1, 10);
+
+    // Random orientations with random norms, then the cases toQuaternion handles specially:
+    // identity and half turns around each axis, where several diagonal terms tie
+    std::vector<Quaternion> quaternions;
+    quaternions.reserve(COUNT);
+    quaternions.push_back(Quaternion(1, 0, 0, 0));
+    quaternions.push_back(Quaternion(0, 1, 0, 0));
+    quaternions.push_back(Quaternion(0, 0, 1, 0));
+    quaternions.push_back(Quaternion(0, 0, 0, 1));
+    quaternions.push_back(Quaternion(0, 1, 1, 0));
+    quaternions.push_back(Quaternion(1, 0, 0, 1));
+    while (quaternions.size() < COUNT) {
+        double factor = scale(random);
+        quaternions.push_back(Quaternion(normal(random) * factor, normal(random) * factor,
+                                         normal(random) * factor, normal(random) * factor));
+    }
+
+    std::vector<RotationMatrix> matrices;
+    matrices.reserve(COUNT);
+    for (Quaternion& q : quaternions)
+        matrices.push_back(q.getRotationMatrix());
+
+    std::vector<RotationMatrix> batchMatrices(COUNT, RotationMatrix(0, 0, 0, 0, 0, 0, 0, 0, 0));
+    Quaternion::toRotationMatrices(quaternions.data(), batchMatrices.data(), COUNT);
+
+    std::vector<Quaternion> batchQuaternions(COUNT, Quaternion(0, 0, 0, 0));
+    RotationMatrix::toQuaternions(matrices.data(), batchQuaternions.data(), COUNT);
+
+    double worstMatrix = 0;
+    double worstQuaternion = 0;
+    for (size_t i = 0; i < COUNT; ++i) {
+        worstMatrix = fmax(worstMatrix, matrixError(matrices[i], batchMatrices[i]));
+        worstQuaternion = fmax(worstQuaternion, quaternionError(matrices[i].toQuaternion(), batchQuaternions[i]));
+    }
+
+    printf("toRotationMatrices: max error %g\n", worstMatrix);
+    printf("toQuaternions: max error %g\n", worstQuaternion);
+
+    if (!(worstMatrix <= TOLERANCE) || !(worstQuaternion <= TOLERANCE)) {
+        fprintf(stderr, "ERROR::TEST::CONVERSIONS::TOLERANCE_EXCEEDED\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+// ImuIntegrator against the same integration done one device at a time with Quaternion
+#include "../imu.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static double orientationError(const Quaternion& left, const Quaternion& right) {
+    // q and -q are the same orientation
+    double dot = fabs(left.a * right.a + left.b * right.b + left.c * right.c + left.d * right.d);
+    return 1 - (dot < 1 ? dot : 1);
+}
+
+int main() {
+    const size_t DEVICES = 257;
+    const size_t SAMPLES = 2000;
+    const double DT = 1.0 / 500;
+
+    std::mt19937_64 random(7);
+    std::uniform_real_distribution<double> rate(-20, 20);
+
+    // Sample-major rates, device 0 stays at rest to cover the zero angular velocity case
+    std::vector<double> wx(DEVICES * SAMPLES), wy(DEVICES * SAMPLES), wz(DEVICES * SAMPLES);
+    for (size_t i = 0; i < wx.size(); ++i) {
+        bool resting = i % DEVICES == 0;
+        wx[i] = resting ? 0 : rate(random);
+        wy[i] = resting ? 0 : rate(random);
+        wz[i] = resting ? 0 : rate(random);
+    }
+
+    ImuIntegrator exponential = ImuIntegrator(DEVICES, ImuIntegrator::EXPONENTIAL_MAP);
+    exponential.integrate(wx.data(), wy.data(), wz.data(), SAMPLES, DT);
+
+    ImuIntegrator rungeKutta = ImuIntegrator(DEVICES, ImuIntegrator::RUNGE_KUTTA_4);
+    rungeKutta.integrate(wx.data(), wy.data(), wz.data(), SAMPLES, DT);
+
+    double worstExponential = 0;
+    double worstRungeKutta = 0;
+    for (size_t device = 0; device < DEVICES; ++device) {
+        Quaternion expected = Quaternion(1, 0, 0, 0);
+        for (size_t sample = 0; sample < SAMPLES; ++sample) {
+            size_t i = sample * DEVICES + device;
+            Quaternion halfStep = Quaternion(0, wx[i] * DT / 2, wy[i] * DT / 2, wz[i] * DT / 2);
+            expected = expected.multiply(halfStep.exp()).getUnit();
+        }
+
+        worstExponential = fmax(worstExponential, orientationError(expected, exponential.getOrientation(device)));
+        worstRungeKutta = fmax(worstRungeKutta, orientationError(expected, rungeKutta.getOrientation(device)));
+    }
+
+    printf("exponential map: max 1 - |dot| %g\n", worstExponential);
+    printf("runge-kutta 4: max 1 - |dot| %g\n", worstRungeKutta);
+
+    // The exponential map is exact for piecewise constant rates, RK4 interpolates them and only has to stay close
+    if (!(worstExponential < 1e-12) || !(worstRungeKutta < 1e-3)) {
+        fprintf(stderr, "ERROR::TEST::IMU::TOLERANCE_EXCEEDED\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+// OrientationIndex queries against a brute-force scan, save/load round trip and rejection of damaged files
+#include "../orientation_index.h"
+#include "../quaternion_stream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Every orientation sorted by angle to the query
+static std::vector<OrientationMatch> scanAll(const std::vector<Quaternion>& orientations, const Quaternion& query) {
+    std::vector<OrientationMatch> matches;
+    for (size_t i = 0; i < orientations.size(); ++i)
+        matches.push_back({i, OrientationIndex::angleBetween(orientations[i], query)});
+    std::sort(matches.begin(), matches.end(),
+              [](const OrientationMatch& left, const OrientationMatch& right) { return left.angle < right.angle; });
+    return matches;
+}
+
+// Same angles as the scan (indices may differ between equally distant orientations), and each index at its angle
+static bool matchesScan(const std::vector<Quaternion>& orientations, const Quaternion& query,
+                        const OrientationMatch* matches, size_t count, const std::vector<OrientationMatch>& expected) {
+    const double TOLERANCE = 1e-12;
+    for (size_t i = 0; i < count; ++i) {
+        if (matches[i].index >= orientations.size() || fabs(matches[i].angle - expected[i].angle) > TOLERANCE
+            || fabs(OrientationIndex::angleBetween(orientations[matches[i].index], query) - matches[i].angle) > TOLERANCE)
+            return false;
+    }
+    return true;
+}
+
+static std::vector<unsigned char> readFile(const char* path) {
+    std::vector<unsigned char> data;
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr)
+        return data;
+
+    unsigned char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + read);
+    fclose(file);
+    return data;
+}
+
+static void writeFile(const char* path, const std::vector<unsigned char>& data) {
+    FILE* file = fopen(path, "wb");
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+}
+
+int main() {
+    const size_t COUNT = 20000;
+    const size_t QUERIES = 300;
+    const size_t K = 10;
+    const char* PATH = "test_orientation_index.bin";
+    const char* DAMAGED_PATH = "test_orientation_index_damaged.bin";
+
+    std::mt19937_64 random(13);
+    std::normal_distribution<double> normal;
+    std::normal_distribution<double> jitter(0, 1e-3);
+
+    // Random orientations of random norms, some of them stored as their opposite
+    std::vector<Quaternion> orientations(COUNT, Quaternion(1, 0, 0, 0));
+    for (Quaternion& q : orientations)
+        q = Quaternion(normal(random), normal(random), normal(random), normal(random));
+
+    // Random queries, then queries next to the opposite of a stored orientation (same rotation, dot close to -1)
+    std::vector<Quaternion> queries;
+    for (size_t i = 0; i < QUERIES; ++i) {
+        if (i % 2 == 0) {
+            queries.push_back(Quaternion(normal(random), normal(random), normal(random), normal(random)));
+        } else {
+            Quaternion q = orientations[random() % COUNT].getUnit();
+            queries.push_back(Quaternion(-q.a + jitter(random), -q.b + jitter(random), -q.c + jitter(random), -q.d + jitter(random)));
+        }
+    }
+
+    OrientationIndex index;
+    index.build(orientations.data(), COUNT);
+
+    std::vector<OrientationMatch> batch(QUERIES * K);
+    index.nearestBatch(queries.data(), QUERIES, K, batch.data());
+
+    size_t nearestMismatches = 0, withinMismatches = 0, batchMismatches = 0;
+    for (size_t i = 0; i < QUERIES; ++i) {
+        std::vector<OrientationMatch> expected = scanAll(orientations, queries[i]);
+
+        std::vector<OrientationMatch> nearest = index.nearest(queries[i], K);
+        if (nearest.size() != K || !matchesScan(orientations, queries[i], nearest.data(), K, expected))
+            nearestMismatches++;
+        if (!matchesScan(orientations, queries[i], &batch[i * K], K, expected))
+            batchMismatches++;
+
+        // Radius around the 50th closest, orientations right at the boundary are left out of the comparison
+        double maxAngle = expected[50].angle;
+        std::vector<OrientationMatch> within = index.withinAngle(queries[i], maxAngle);
+        size_t expectedCount = 0;
+        while (expectedCount < expected.size() && expected[expectedCount].angle <= maxAngle)
+            expectedCount++;
+        bool boundaryTie = expectedCount < expected.size() && expected[expectedCount].angle - maxAngle < 1e-12;
+        if (!boundaryTie && (within.size() != expectedCount
+                             || !matchesScan(orientations, queries[i], within.data(), within.size(), expected)))
+            withinMismatches++;
+    }
+    printf("nearest: %zu mismatches out of %zu queries\n", nearestMismatches, QUERIES);
+    printf("nearestBatch: %zu mismatches\n", batchMismatches);
+    printf("withinAngle: %zu mismatches\n", withinMismatches);
+    bool failed = nearestMismatches != 0 || batchMismatches != 0 || withinMismatches != 0;
+
+    // More neighbours asked than the index holds: every orientation, and SIZE_MAX after them in batches
+    const size_t SMALL_COUNT = 37;
+    std::vector<Quaternion> few(orientations.begin(), orientations.begin() + SMALL_COUNT);
+    OrientationIndex small;
+    small.build(few.data(), SMALL_COUNT);
+    std::vector<OrientationMatch> smallExpected = scanAll(few, queries[0]);
+    std::vector<OrientationMatch> all = small.nearest(queries[0], SMALL_COUNT + 5);
+    std::vector<OrientationMatch> smallBatch(SMALL_COUNT + 5);
+    small.nearestBatch(&queries[0], 1, SMALL_COUNT + 5, smallBatch.data());
+    bool largeKCorrect = all.size() == SMALL_COUNT && matchesScan(few, queries[0], all.data(), SMALL_COUNT, smallExpected)
+                         && matchesScan(few, queries[0], smallBatch.data(), SMALL_COUNT, smallExpected);
+    for (size_t i = SMALL_COUNT; i < smallBatch.size(); ++i)
+        largeKCorrect = largeKCorrect && smallBatch[i].index == SIZE_MAX;
+    printf("k larger than the index: %s\n", largeKCorrect ? "correct" : "WRONG");
+    failed |= !largeKCorrect;
+
+    // Round trip: the loaded index answers exactly like the saved one
+    bool roundTrip = index.save(PATH);
+    OrientationIndex loaded;
+    roundTrip = roundTrip && loaded.load(PATH) && loaded.size() == COUNT;
+    for (size_t i = 0; roundTrip && i < QUERIES; ++i) {
+        std::vector<OrientationMatch> before = index.nearest(queries[i], K);
+        std::vector<OrientationMatch> after = loaded.nearest(queries[i], K);
+        for (size_t j = 0; j < K; ++j)
+            roundTrip = roundTrip && before[j].index == after[j].index && before[j].angle == after[j].angle;
+    }
+    printf("save/load round trip: %s\n", roundTrip ? "identical" : "DIFFERENT");
+    failed |= !roundTrip;
+
+    // File layout: magic, version, count, points (4 doubles each), ids, nodes (threshold, insideEnd), CRC-32
+    std::vector<unsigned char> file = readFile(PATH);
+    size_t nodesOffset = 16 + COUNT * 4 * sizeof(double) + COUNT * sizeof(uint64_t);
+
+    std::vector<unsigned char> corrupted = file;
+    corrupted[16 + 100] ^= 0x01;
+    writeFile(DAMAGED_PATH, corrupted);
+    OrientationIndex damaged;
+    bool checksumRejected = !damaged.load(DAMAGED_PATH);
+
+    // A child range past the end of the tree, with a checksum that matches so only the structure check can catch it
+    std::vector<unsigned char> outOfRange = file;
+    uint64_t insideEnd = COUNT + 1000;
+    memcpy(&outOfRange[nodesOffset + sizeof(double)], &insideEnd, sizeof(insideEnd));
+    uint32_t checksum = computeCrc32(&outOfRange[16], outOfRange.size() - 16 - sizeof(uint32_t));
+    memcpy(&outOfRange[outOfRange.size() - sizeof(uint32_t)], &checksum, sizeof(checksum));
+    writeFile(DAMAGED_PATH, outOfRange);
+    bool structureRejected = !damaged.load(DAMAGED_PATH);
+
+    printf("bad checksum rejected: %s\n", checksumRejected ? "yes" : "no");
+    printf("out of range insideEnd rejected: %s\n", structureRejected ? "yes" : "no");
+    failed |= !checksumRejected || !structureRejected;
+
+    remove(PATH);
+    remove(DAMAGED_PATH);
+
+    if (failed) {
+        fprintf(stderr, "ERROR::TEST::ORIENTATION_INDEX::MISMATCH\n");
+        return 1;
+    }
+
+    return 0;
+}
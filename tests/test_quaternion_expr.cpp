@@ -0,0 +1,76 @@
+// Quaternion expressions against the same computation done with the Quaternion methods
+#include "../library.h"
+#include "../quaternion_expr.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <type_traits>
+
+// q * v * ~q must pick the sandwich rewrite
+static_assert(std::is_same<decltype(std::declval<const Quaternion&>() * std::declval<const Quaternion&>()
+                                    * ~std::declval<const Quaternion&>()),
+                           QuaternionProduct<QuaternionProduct<QuaternionTerm, QuaternionTerm>,
+                                             QuaternionConjugate<QuaternionTerm>>>::value,
+              "q * v * ~q is not the sandwich expression");
+
+static double relativeError(const Quaternion& result, Quaternion expected) {
+    double error = fmax(fmax(fabs(result.a - expected.a), fabs(result.b - expected.b)),
+                        fmax(fabs(result.c - expected.c), fabs(result.d - expected.d)));
+    return error / fmax(1, expected.getNorm());
+}
+
+int main() {
+    const double TOLERANCE = 1e-13;
+    const int COUNT = 100000;
+
+    std::mt19937_64 random(9);
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<double> scale(0.1, 10);
+
+    double worstSandwich = 0, worstFallback = 0, worstMixed = 0, worstRotate = 0;
+    for (int i = 0; i < COUNT; ++i) {
+        // Quaternions of any norm, the vector part has a real part too so the rewrite must keep it
+        Quaternion q = Quaternion(normal(random), normal(random), normal(random), normal(random)).multiply(scale(random));
+        Quaternion r = Quaternion(normal(random), normal(random), normal(random), normal(random));
+        Quaternion v = Quaternion(normal(random), normal(random), normal(random), normal(random));
+
+        // Rewritten sandwich
+        Quaternion sandwich = q * v * ~q;
+        worstSandwich = fmax(worstSandwich, relativeError(sandwich, q.multiply(v).multiply(q.conjugate())));
+
+        // Same expression type with different outer operands: the two products are kept
+        Quaternion fallback = q * v * ~r;
+        worstFallback = fmax(worstFallback, relativeError(fallback, q.multiply(v).multiply(r.conjugate())));
+
+        // The other nodes, and a sandwich whose middle is itself an expression
+        Quaternion mixed = (q * r + v) * ~(r + q);
+        worstMixed = fmax(worstMixed, relativeError(mixed, q.multiply(r).add(v).multiply(r.add(q).conjugate())));
+        Quaternion nested = q * (v + r) * ~q;
+        worstMixed = fmax(worstMixed, relativeError(nested, q.multiply(v.add(r)).multiply(q.conjugate())));
+
+        // Double3::rotate, which uses the rewrite, against the method chain it replaced
+        Double3 point = Double3(normal(random), normal(random), normal(random));
+        Double3 origin = Double3(normal(random), normal(random), normal(random));
+        Double3 rotated = point.rotate(q, origin);
+
+        Quaternion unit = q.getUnit();
+        Quaternion chain = unit.multiply(Quaternion(0, point.x - origin.x, point.y - origin.z, point.z - origin.y))
+                .multiply(unit.conjugate());
+        Double3 expected = Double3(chain.b + origin.x, chain.d + origin.y, chain.c + origin.z);
+        worstRotate = fmax(worstRotate, fmax(fmax(fabs(rotated.x - expected.x), fabs(rotated.y - expected.y)),
+                                             fabs(rotated.z - expected.z)));
+    }
+
+    printf("q * v * ~q: max relative error %g\n", worstSandwich);
+    printf("q * v * ~r: max relative error %g\n", worstFallback);
+    printf("sums and nested products: max relative error %g\n", worstMixed);
+    printf("Double3::rotate: max error %g\n", worstRotate);
+
+    if (!(worstSandwich < TOLERANCE) || !(worstFallback < TOLERANCE) || !(worstMixed < TOLERANCE) || !(worstRotate < TOLERANCE)) {
+        fprintf(stderr, "ERROR::TEST::QUATERNION_EXPR::TOLERANCE_EXCEEDED\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+// QuaternionMatrix::multiply, fast path and general kernel, against a plain 4x4 product
+#include "../library.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+static_assert(sizeof(QuaternionMatrix) == 128, "QuaternionMatrix must stay 16 doubles");
+static_assert(alignof(QuaternionMatrix) == 32, "QuaternionMatrix must be 32-byte aligned");
+
+// Largest difference between result and the textbook product of left and right, relative to the entries
+static double productError(const QuaternionMatrix& result, const QuaternionMatrix& left, const QuaternionMatrix& right) {
+    double error = 0, scale = 1;
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            double expected = 0;
+            for (int k = 0; k < 4; ++k)
+                expected += left.at(row, k) * right.at(k, column);
+            error = fmax(error, fabs(result.at(row, column) - expected));
+            scale = fmax(scale, fabs(expected));
+        }
+    }
+    return error / scale;
+}
+
+int main() {
+    const double TOLERANCE = 1e-14;
+    const int COUNT = 100000;
+
+    std::mt19937_64 random(17);
+    std::normal_distribution<double> normal;
+    bool failed = false;
+
+    double worstFast = 0, worstGeneral = 0, worstEdited = 0;
+    int wrongForm = 0;
+    for (int i = 0; i < COUNT; ++i) {
+        Quaternion p = Quaternion(normal(random), normal(random), normal(random), normal(random));
+        Quaternion q = Quaternion(normal(random), normal(random), normal(random), normal(random));
+
+        // Both quaternion matrices: the fast path, whose result is again a quaternion matrix
+        QuaternionMatrix left = p.toMatrix();
+        QuaternionMatrix right = q.toMatrix();
+        QuaternionMatrix fast = left.multiply(right);
+        wrongForm += !left.isQuaternionForm() || !right.isQuaternionForm() || !fast.isQuaternionForm();
+        worstFast = fmax(worstFast, productError(fast, left, right));
+
+        // Arbitrary matrices: the general kernel
+        QuaternionMatrix general = QuaternionMatrix(
+                normal(random), normal(random), normal(random), normal(random),
+                normal(random), normal(random), normal(random), normal(random),
+                normal(random), normal(random), normal(random), normal(random),
+                normal(random), normal(random), normal(random), normal(random));
+        wrongForm += general.isQuaternionForm();
+        worstGeneral = fmax(worstGeneral, productError(general.multiply(right), general, right));
+        worstGeneral = fmax(worstGeneral, productError(right.multiply(general), right, general));
+
+        // Quaternion matrices edited through set() or a field are no longer quaternion matrices and must
+        // take the general kernel
+        QuaternionMatrix edited = p.toMatrix();
+        edited.set(i % 4, (i / 4) % 4, normal(random));
+        QuaternionMatrix fieldEdited = q.toMatrix();
+        fieldEdited.c4 += 1;
+        wrongForm += edited.isQuaternionForm() || fieldEdited.isQuaternionForm();
+        worstEdited = fmax(worstEdited, productError(edited.multiply(right), edited, right));
+        worstEdited = fmax(worstEdited, productError(left.multiply(fieldEdited), left, fieldEdited));
+    }
+
+    printf("fast path: max relative error %g\n", worstFast);
+    printf("general kernel: max relative error %g\n", worstGeneral);
+    printf("edited quaternion matrices: max relative error %g\n", worstEdited);
+    printf("misdetected quaternion form: %d\n", wrongForm);
+    failed |= !(worstFast < TOLERANCE) || !(worstGeneral < TOLERANCE) || !(worstEdited < TOLERANCE) || wrongForm != 0;
+
+    if (failed) {
+        fprintf(stderr, "ERROR::TEST::QUATERNION_MATRIX::TOLERANCE_EXCEEDED\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+// Quaternion stream round trips for every encoding, and rejection of damaged streams
+#include "../quaternion_stream.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Angle in degrees of the rotation from left to right, both unit quaternions
+static double angleBetween(const Quaternion& left, const Quaternion& right) {
+    // q and -q are the same orientation
+    double dot = fabs(left.a * right.a + left.b * right.b + left.c * right.c + left.d * right.d);
+    return 2 * acos(dot < 1 ? dot : 1) * 180 / M_PI;
+}
+
+// Every chunk of the stream decoded one after the other, false when reading stops on an error
+static bool readQuaternions(const std::vector<unsigned char>& data, std::vector<Quaternion>& out) {
+    StreamReader reader = StreamReader(data.data(), data.size());
+    if (!reader.isValid())
+        return false;
+
+    out.clear();
+    StreamChunkView chunk;
+    while (reader.next(chunk)) {
+        size_t begin = out.size();
+        out.resize(begin + chunk.count, Quaternion(1, 0, 0, 0));
+        if (!chunk.decodeQuaternions(out.data() + begin))
+            return false;
+    }
+    return reader.getError() == nullptr;
+}
+
+// Records of the first chunk after the stream header
+static const size_t CHUNK_PAYLOAD_OFFSET = 16 + 24;
+
+static void rewriteChecksum(std::vector<unsigned char>& data) {
+    uint64_t payloadSize;
+    memcpy(&payloadSize, &data[16 + 8], sizeof(payloadSize));
+    uint32_t checksum = computeCrc32(&data[CHUNK_PAYLOAD_OFFSET], payloadSize);
+    memcpy(&data[16 + 16], &checksum, sizeof(checksum));
+}
+
+int main() {
+    const size_t COUNTS[] = {0, 1, 255, 256, 257, StreamWriter::CHUNK_RECORDS + 300};
+    const StreamEncoding ENCODINGS[] = {
+            STREAM_QUATERNION_SMALLEST3_29, STREAM_QUATERNION_SMALLEST3_32, STREAM_QUATERNION_SMALLEST3_48,
+            STREAM_QUATERNION_DELTA_29, STREAM_QUATERNION_DELTA_32, STREAM_QUATERNION_DELTA_48
+    };
+    const int COMPONENT_BITS[] = {9, 10, 15, 9, 10, 15};
+
+    std::mt19937_64 random(11);
+    std::normal_distribution<double> normal(0, 1);
+    bool failed = false;
+
+    for (size_t count : COUNTS) {
+        // Uniformly distributed unit quaternions, with a zero quaternion second when there is room for it
+        std::vector<Quaternion> quaternions(count, Quaternion(1, 0, 0, 0));
+        for (Quaternion& q : quaternions)
+            q = Quaternion(normal(random), normal(random), normal(random), normal(random)).getUnit();
+        if (count > 1)
+            quaternions[1] = Quaternion(0, 0, 0, 0);
+
+        std::vector<Double3> vectors(count);
+        for (Double3& v : vectors)
+            v = Double3(normal(random), normal(random), normal(random));
+
+        // Raw records are copied bit for bit
+        StreamWriter rawWriter;
+        rawWriter.writeQuaternions(quaternions.data(), count);
+        rawWriter.writeDouble3s(vectors.data(), count);
+        StreamReader rawReader = StreamReader(rawWriter.data.data(), rawWriter.data.size());
+        std::vector<Quaternion> rawQuaternions;
+        std::vector<Double3> rawVectors;
+        StreamChunkView chunk;
+        while (rawReader.next(chunk)) {
+            if (chunk.isQuaternion()) {
+                rawQuaternions.resize(rawQuaternions.size() + chunk.count, Quaternion(1, 0, 0, 0));
+                chunk.decodeQuaternions(rawQuaternions.data() + rawQuaternions.size() - chunk.count);
+            } else {
+                rawVectors.resize(rawVectors.size() + chunk.count);
+                chunk.decodeDouble3s(rawVectors.data() + rawVectors.size() - chunk.count);
+            }
+        }
+        bool rawExact = rawReader.getError() == nullptr && rawQuaternions.size() == count && rawVectors.size() == count
+                        && memcmp(rawQuaternions.data(), quaternions.data(), count * sizeof(Quaternion)) == 0
+                        && memcmp(rawVectors.data(), vectors.data(), count * sizeof(Double3)) == 0;
+        printf("%6zu records  raw: %s\n", count, rawExact ? "exact" : "MISMATCH");
+        failed |= !rawExact;
+
+        for (size_t e = 0; e < sizeof(ENCODINGS) / sizeof(ENCODINGS[0]); ++e) {
+            StreamWriter writer;
+            writer.writeQuaternions(quaternions.data(), count, ENCODINGS[e]);
+
+            std::vector<Quaternion> decoded;
+            if (!readQuaternions(writer.data, decoded) || decoded.size() != count) {
+                printf("%6zu records  encoding %d: decoding failed\n", count, ENCODINGS[e]);
+                failed = true;
+                continue;
+            }
+
+            double worst = 0;
+            for (size_t i = 0; i < count; ++i) {
+                Quaternion expected = i == 1 ? Quaternion(1, 0, 0, 0) : quaternions[i];
+                worst = fmax(worst, angleBetween(expected, decoded[i]));
+            }
+            // Each kept component is off by at most half a step d and the dropped one, at least 1/2, by at most 3d,
+            // so the quaternion moves by at most 2 sqrt(3) d and the rotation angle by twice that
+            double halfStep = M_SQRT1_2 / ((1 << COMPONENT_BITS[e]) - 1);
+            double tolerance = 4 * sqrt(3.0) * halfStep * 180 / M_PI;
+            printf("%6zu records  encoding %d: max angle %g degrees (bound %g)\n", count, ENCODINGS[e], worst, tolerance);
+            failed |= !(worst < tolerance);
+        }
+    }
+
+    // Damaged streams are rejected instead of decoded
+    std::vector<Quaternion> quaternions(1000, Quaternion(1, 0, 0, 0));
+    for (Quaternion& q : quaternions)
+        q = Quaternion(normal(random), normal(random), normal(random), normal(random)).getUnit();
+    std::vector<Quaternion> decoded;
+
+    StreamWriter packedWriter;
+    packedWriter.writeQuaternions(quaternions.data(), quaternions.size(), STREAM_QUATERNION_SMALLEST3_32);
+    std::vector<unsigned char> corrupted = packedWriter.data;
+    corrupted[CHUNK_PAYLOAD_OFFSET + 100] ^= 0x10;
+    std::vector<unsigned char> truncated(packedWriter.data.begin(), packedWriter.data.end() - 8);
+
+    // A delta chunk claiming more records than its payload can hold, with a checksum that matches
+    StreamWriter deltaWriter;
+    deltaWriter.writeQuaternions(quaternions.data(), quaternions.size(), STREAM_QUATERNION_DELTA_48);
+    std::vector<unsigned char> oversized = deltaWriter.data;
+    uint64_t payloadSize;
+    memcpy(&payloadSize, &oversized[16 + 8], sizeof(payloadSize));
+    uint32_t count = (uint32_t)(payloadSize / 3 + 1);
+    memcpy(&oversized[16 + 4], &count, sizeof(count));
+    rewriteChecksum(oversized);
+
+    bool corruptedRejected = !readQuaternions(corrupted, decoded);
+    bool truncatedRejected = !readQuaternions(truncated, decoded);
+    bool oversizedRejected = !readQuaternions(oversized, decoded);
+    printf("corrupted payload rejected: %s\n", corruptedRejected ? "yes" : "no");
+    printf("truncated payload rejected: %s\n", truncatedRejected ? "yes" : "no");
+    printf("oversized delta count rejected: %s\n", oversizedRejected ? "yes" : "no");
+    failed |= !corruptedRejected || !truncatedRejected || !oversizedRejected;
+
+    if (failed) {
+        fprintf(stderr, "ERROR::TEST::QUATERNION_STREAM::TOLERANCE_EXCEEDED\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+#ifndef QUATERNION_VECTOR_MATH_H
+#define QUATERNION_VECTOR_MATH_H
+
+#include <cstdint>
+#include <cstring>
+
+// Elementary functions without calls or branches, for loops that have to be vectorized. The standard library
+// versions are calls, and float comparisons stay branches under the default -ftrapping-math, so selections are
+// done on the bit patterns with integer masks. The polynomials are the Cephes ones, within 1 or 2 ulp of the
+// standard library on the documented ranges.
+
+inline uint64_t bitsOf(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline double doubleOf(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// mask ? right : left, on bit patterns
+inline uint64_t selectBits(uint64_t mask, uint64_t left, uint64_t right) {
+    return (left & ~mask) | (right & mask);
+}
+
+// All ones when left < right, for non-negative doubles (their bit patterns order like the values)
+inline uint64_t lessMask(double left, double right) {
+    return 0 - ((bitsOf(left) - bitsOf(right)) >> 63);
+}
+
+// sin(x) and cos(x). Reduction by pi/2 in three parts (Cody-Waite) and the polynomials on [-pi/4, pi/4],
+// for |x| up to a few thousand radians.
+inline void sinCos(double x, double& sine, double& cosine) {
+    // Nearest integer to x / (pi/2) with the 1.5 * 2^52 rounding trick, whose low bits then hold it
+    double shifted = x * 0.63661977236758134308 + 6755399441055744.0;
+    double k = shifted - 6755399441055744.0;
+    uint64_t quadrant = bitsOf(shifted);
+
+    double r = ((x - k * 1.57079625129699707031) - k * 7.54978941586159635335e-8) - k * 5.39030285815811905290e-15;
+    double r2 = r * r;
+    double s = r + r * r2 * (((((1.58962301576546568060e-10 * r2 - 2.50507477628578072866e-8) * r2
+                                + 2.75573136213857245213e-6) * r2 - 1.98412698295895385996e-4) * r2
+                              + 8.33333333332211858878e-3) * r2 - 1.66666666666666307295e-1);
+    double c = 1 - 0.5 * r2 + r2 * r2 * (((((-1.13585365213876817300e-11 * r2 + 2.08757008419747316778e-9) * r2
+                                            - 2.75573141792967388112e-7) * r2 + 2.48015872888517045348e-5) * r2
+                                          - 1.38888888888730564116e-3) * r2 + 4.16666666666665929218e-2);
+
+    // Odd quadrants swap sine and cosine, the sign bits follow the quadrant
+    uint64_t swap = 0 - (quadrant & 1);
+    sine = doubleOf(selectBits(swap, bitsOf(s), bitsOf(c)) ^ ((quadrant & 2) << 62));
+    cosine = doubleOf(selectBits(swap, bitsOf(c), bitsOf(s)) ^ (((quadrant + 1) & 2) << 62));
+}
+
+// exp(x). Overflows to infinity above 709 and gives 0 below -709, NaN is not preserved.
+inline double expPolynomial(double x) {
+    // Out of range values are computed at +-709 and replaced at the end
+    uint64_t sign = bitsOf(x) & 0x8000000000000000ull;
+    uint64_t outOfRange = lessMask(709, doubleOf(bitsOf(x) & ~sign));
+    x = doubleOf(selectBits(outOfRange, bitsOf(x), bitsOf(709.0) | sign));
+
+    // x = k ln(2) + r with |r| <= ln(2) / 2, ln(2) in two parts
+    double shifted = x * 1.4426950408889634074 + 6755399441055744.0;
+    double k = shifted - 6755399441055744.0;
+    double r = (x - k * 6.93145751953125e-1) - k * 1.42860682030941723212e-6;
+
+    double r2 = r * r;
+    double p = r * ((1.26177193074810590878e-4 * r2 + 3.02994407707441961300e-2) * r2 + 9.99999999999999999910e-1);
+    double q = ((3.00198505138664455042e-6 * r2 + 2.52448340349684104192e-3) * r2 + 2.27265548208155028766e-1) * r2
+               + 2.00000000000000000009;
+    double e = 1 + 2 * (p / (q - p));
+
+    // 2^k from the low bits of shifted, everything above them is shifted out
+    double result = e * doubleOf((bitsOf(shifted) + 1023) << 52);
+    uint64_t limit = 0x7FF0000000000000ull & ~(0 - (sign >> 63));
+    return doubleOf(selectBits(outOfRange, bitsOf(result), limit));
+}
+
+// log(x) for positive normal x, 0 gives -infinity
+inline double logPolynomial(double x) {
+    // x = m 2^e with m in [sqrt(1/2), sqrt(2))
+    uint64_t bits = bitsOf(x);
+    double m = doubleOf((bits & 0x000FFFFFFFFFFFFFull) | 0x3FE0000000000000ull);
+    uint64_t low = lessMask(m, 0.70710678118654752440);
+    uint64_t e = (bits >> 52) - 1022 - (low & 1);
+    double f = doubleOf(selectBits(low, bitsOf(m - 1), bitsOf(m + m - 1)));
+    // The integer e as a double, the 1.5 * 2^52 rounding trick in reverse
+    double exponent = doubleOf(e + 0x4338000000000000ull) - 6755399441055744.0;
+
+    double z = f * f;
+    double p = ((((1.01875663804580931796e-4 * f + 4.97494994976747001425e-1) * f + 4.70579119878881725854) * f
+                 + 1.44989225341610930846e1) * f + 1.79368678507819816313e1) * f + 7.70838733755885391666;
+    double q = ((((f + 1.12873587189167450590e1) * f + 4.52279145837532221105e1) * f + 8.29875266912776603211e1) * f
+                + 7.11544750618563894466e1) * f + 2.31251620126765340583e1;
+    double y = f * (z * p / q) - exponent * 2.121944400546905827679e-4 - 0.5 * z;
+    double result = f + y + exponent * 0.693359375;
+
+    uint64_t zero = 0 - ((bits - 1) >> 63);
+    return doubleOf(selectBits(zero, bitsOf(result), 0xFFF0000000000000ull));
+}
+
+// atan2(y, x) for y >= 0, in [0, pi]. atan2(0, 0) is 0.
+inline double atan2Polynomial(double y, double x) {
+    // atan of the smaller over the larger, in [0, 1]
+    double absX = doubleOf(bitsOf(x) & ~0x8000000000000000ull);
+    uint64_t steep = lessMask(absX, y);
+    double ratio = doubleOf(selectBits(steep, bitsOf(y), bitsOf(absX)))
+                   / (doubleOf(selectBits(steep, bitsOf(absX), bitsOf(y))) + 1e-300);
+
+    // Above tan(pi/8), atan(t) = pi/4 + atan((t - 1) / (t + 1))
+    uint64_t high = lessMask(0.41421356237309504880, ratio);
+    double t = doubleOf(selectBits(high, bitsOf(ratio), bitsOf((ratio - 1) / (ratio + 1))));
+    double t2 = t * t;
+    double p = (((-8.750608600031904122785e-1 * t2 - 1.615753718733365076637e1) * t2 - 7.500855792314704667340e1) * t2
+                - 1.228866684490136173410e2) * t2 - 6.485021904942025371773e1;
+    double q = ((((t2 + 2.485846490142306297962e1) * t2 + 1.650270098316988542046e2) * t2 + 4.328810604912902668951e2) * t2
+                + 4.853903996359136964868e2) * t2 + 1.945506571482613964425e2;
+    // The constants added back carry the rounding error of pi/4 and pi/2 separately
+    double angle = t * (t2 * p / q) + t + doubleOf(high & bitsOf(3.061616997868382943065e-17))
+                   + doubleOf(high & bitsOf(0.78539816339744830962));
+
+    angle = doubleOf(selectBits(steep, bitsOf(angle), bitsOf((1.57079632679489661923 - angle) + 6.123233995736765886130e-17)));
+    uint64_t negative = 0 - (bitsOf(x) >> 63);
+    return doubleOf(selectBits(negative, bitsOf(angle), bitsOf((3.14159265358979323846 - angle) + 1.224646799147353177226e-16)));
+}
+
+#endif //QUATERNION_VECTOR_MATH_H